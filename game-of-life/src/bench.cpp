@@ -0,0 +1,291 @@
+// Benchmarks every stepping strategy of the Game of Life on the same workloads and checks that all
+// of them agree on the resulting board.
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "game_state.hpp"
+#include "mapped_board.hpp"
+#include "packed_rows.hpp"
+#include "striped_board.hpp"
+
+// Every run steps about this many cells in total, whatever the board size.
+const uint64_t BENCH_CELL_UPDATES = (uint64_t)1 << 25;
+const unsigned int BENCH_MIN_GENERATIONS = 8;
+
+const unsigned int BENCH_GLIDER_SPACING = 16;
+const unsigned int BENCH_METHUSELAH_SPACING = 24;
+
+using PackedBoard = std::vector<uint64_t>;
+
+struct Workload {
+    std::string name;
+    PackedBoard board;
+};
+
+// Steps the packed board in place by the given number of generations.
+struct Engine {
+    std::string name;
+    // Cache misses can't be attributed to the engines that run in other processes.
+    bool countsCacheMisses;
+    std::function<bool(PackedBoard&, unsigned int)> run;
+};
+
+// Counts the last-level cache misses of the calling thread, when the kernel lets us.
+class CacheMissCounter {
+  private:
+    int fd;
+
+  public:
+    CacheMissCounter() {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~CacheMissCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool isAvailable() const {
+        return fd >= 0;
+    }
+
+    void start() {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+        return count;
+    }
+};
+
+void setCell(PackedBoard& board, unsigned int cols, unsigned int rows, unsigned int x, unsigned int y) {
+    if (x < cols && y < rows) {
+        board[y * packedRowWords(cols) + x / 64] |= (uint64_t)1 << (x % 64);
+    }
+}
+
+PackedBoard randomSoup(unsigned int cols, unsigned int rows, double density) {
+    std::mt19937_64 rng{cols * 31 + rows};
+    std::bernoulli_distribution alive{density};
+    PackedBoard board(packedRowWords(cols) * rows, 0);
+    for (unsigned int y = 0; y < rows; y++) {
+        for (unsigned int x = 0; x < cols; x++) {
+            if (alive(rng)) {
+                setCell(board, cols, rows, x, y);
+            }
+        }
+    }
+    return board;
+}
+
+// Stamps the pattern, given as a list of (x, y) offsets, on a regular grid of the board.
+PackedBoard tiledPattern(unsigned int cols, unsigned int rows, unsigned int spacing, const std::vector<std::pair<unsigned int, unsigned int>>& cells) {
+    PackedBoard board(packedRowWords(cols) * rows, 0);
+    for (unsigned int tileY = 0; tileY + spacing <= rows; tileY += spacing) {
+        for (unsigned int tileX = 0; tileX + spacing <= cols; tileX += spacing) {
+            for (const auto& cell : cells) {
+                setCell(board, cols, rows, tileX + cell.first, tileY + cell.second);
+            }
+        }
+    }
+    return board;
+}
+
+std::vector<Workload> makeWorkloads(unsigned int cols, unsigned int rows) {
+    std::vector<Workload> workloads;
+    for (double density : {0.1, 0.3, 0.5}) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "soup %.0f%%", density * 100);
+        workloads.push_back({name, randomSoup(cols, rows, density)});
+    }
+    workloads.push_back({"gliders", tiledPattern(cols, rows, BENCH_GLIDER_SPACING, {{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}})});
+    // R-pentominoes packed close enough to interact early on.
+    workloads.push_back({"methuselahs", tiledPattern(cols, rows, BENCH_METHUSELAH_SPACING, {{1, 0}, {2, 0}, {0, 1}, {1, 1}, {1, 2}})});
+    return workloads;
+}
+
+template <unsigned int cols, unsigned int rows>
+std::vector<Engine> makeEngines() {
+    std::vector<Engine> engines;
+
+    // Kept alive across runs, the game state is far too large for the stack.
+    std::shared_ptr<GameState<cols, rows>> game{new GameState<cols, rows>{}};
+    for (bool trackActivity : {false, true}) {
+        engines.push_back({
+            trackActivity ? "GameState + activity" : "GameState",
+            true,
+            [game, trackActivity](PackedBoard& board, unsigned int generations) {
+                game->setActivityTracking(trackActivity);
+                game->unpackCells(board.data());
+                for (unsigned int generation = 0; generation < generations; generation++) {
+                    game->nextIteration();
+                }
+                game->packCells(board.data());
+                return true;
+            },
+        });
+    }
+
+    engines.push_back({
+        "packed rows",
+        true,
+        [](PackedBoard& board, unsigned int generations) {
+            size_t rowWords = packedRowWords(cols);
+            uint64_t lastWordMask = packedLastWordMask(cols);
+            PackedBoard next(board.size(), 0);
+            std::vector<uint64_t> deadRow(rowWords, 0);
+            for (unsigned int generation = 0; generation < generations; generation++) {
+                for (unsigned int y = 0; y < rows; y++) {
+                    stepPackedRow(
+                        y > 0 ? &board[(y - 1) * rowWords] : deadRow.data(),
+                        &board[y * rowWords],
+                        y + 1 < rows ? &board[(y + 1) * rowWords] : deadRow.data(),
+                        &next[y * rowWords],
+                        rowWords,
+                        lastWordMask);
+                }
+                board.swap(next);
+            }
+            return true;
+        },
+    });
+
+    // The file is unlinked once mapped, the mapping keeps it alive as long as the engine exists.
+    char mappedPath[] = "/tmp/gol_bench_XXXXXX";
+    int mappedFd = mkstemp(mappedPath);
+    if (mappedFd >= 0) {
+        close(mappedFd);
+        std::shared_ptr<MappedBoard> mapped{new MappedBoard{}};
+        if (mapped->open(mappedPath, cols, rows)) {
+            unlink(mappedPath);
+            engines.push_back({
+                "mapped file",
+                true,
+                [mapped](PackedBoard& board, unsigned int generations) {
+                    mapped->load(board.data());
+                    mapped->step(generations);
+                    mapped->store(board.data());
+                    return true;
+                },
+            });
+        }
+    }
+
+    for (unsigned int workerCount : {2u, 4u}) {
+        std::shared_ptr<StripedBoard> striped{new StripedBoard{cols, rows, workerCount}};
+        if (!striped->start()) {
+            continue;
+        }
+        engines.push_back({
+            "striped x" + std::to_string(workerCount),
+            false,
+            [striped](PackedBoard& board, unsigned int generations) {
+                return striped->load(board.data()) && striped->step(generations) && striped->store(board.data());
+            },
+        });
+    }
+
+    return engines;
+}
+
+template <unsigned int cols, unsigned int rows>
+bool benchmarkSize(CacheMissCounter& counter) {
+    const uint64_t cells = (uint64_t)cols * rows;
+    const unsigned int generations = std::max(BENCH_MIN_GENERATIONS, (unsigned int)(BENCH_CELL_UPDATES / cells));
+
+    std::vector<Engine> engines = makeEngines<cols, rows>();
+    bool allAgree = true;
+    for (const Workload& workload : makeWorkloads(cols, rows)) {
+        PackedBoard reference;
+        for (const Engine& engine : engines) {
+            PackedBoard board = workload.board;
+
+            counter.start();
+            auto start = std::chrono::steady_clock::now();
+            bool ok = engine.run(board, generations);
+            auto end = std::chrono::steady_clock::now();
+            uint64_t cacheMisses = counter.stop();
+
+            double nanos = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            double cellUpdates = (double)cells * generations;
+
+            const char* verdict = "ok";
+            if (!ok) {
+                verdict = "FAILED";
+                allAgree = false;
+            } else if (reference.empty()) {
+                reference = board;
+            } else if (board != reference) {
+                verdict = "MISMATCH";
+                allAgree = false;
+            }
+
+            char missesPerCell[32] = "n/a";
+            if (counter.isAvailable() && engine.countsCacheMisses) {
+                std::snprintf(missesPerCell, sizeof(missesPerCell), "%.4f", cacheMisses / cellUpdates);
+            }
+            std::printf(
+                "%5ux%-5u %-12s %-22s %10.3f %14s  %s\n",
+                cols,
+                rows,
+                workload.name.c_str(),
+                engine.name.c_str(),
+                nanos / cellUpdates,
+                missesPerCell,
+                verdict);
+        }
+    }
+    return allAgree;
+}
+
+int main() {
+    CacheMissCounter counter{};
+    if (!counter.isAvailable()) {
+        std::cout << "Hardware cache miss counters aren't available, they won't be reported." << std::endl;
+    }
+
+    std::printf("%-11s %-12s %-22s %10s %14s  %s\n", "board", "workload", "engine", "ns/cell", "misses/cell", "check");
+    bool allAgree = true;
+    allAgree &= benchmarkSize<64, 64>(counter);
+    // The size of the interactive board, whose rows end with a partial word.
+    allAgree &= benchmarkSize<100, 100>(counter);
+    allAgree &= benchmarkSize<256, 256>(counter);
+    allAgree &= benchmarkSize<1024, 1024>(counter);
+
+    if (!allAgree) {
+        std::cout << "Some engines disagree on the resulting boards." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Number of frames that can be queued for the writer thread before the simulation has to wait.
+const unsigned int RECORDER_SLOT_COUNT = 256;
+
+enum class FrameFormat {
+    // One bit per cell, rows padded to a whole byte, most significant bit first. Matches the
+    // `monob` pixel format of ffmpeg's rawvideo demuxer.
+    Bit1,
+    // One byte per cell, 255 for alive cells and 0 for dead ones. Matches the `gray` pixel format.
+    Byte8,
+};
+
+// Writes generations as a headerless raw frame stream to a file or to the standard output.
+//
+// Frames are packed by the simulation thread into a ring of preallocated slots and a background
+// thread flushes every run of ready slots with a single write call, so recording does no per-frame
+// allocation and no blocking I/O on the simulation thread. The simulation only waits if the writer
+// falls a whole ring behind.
+//
+// When delta encoding is enabled the first frame is written as is and every following frame is the
+// XOR of itself with its predecessor. Still regions then become zero bytes, which compress very well,
+// and decoding is a running XOR over the frames.
+class FrameRecorder {
+  private:
+    unsigned int cols;
+    unsigned int rows;
+    FrameFormat format;
+    bool deltaEncode;
+    size_t frameBytes;
+
+    std::FILE* output;
+    bool ownsOutput;
+
+    std::unique_ptr<uint8_t[]> slots;
+    std::unique_ptr<uint8_t[]> previousFrame;
+
+    // Frames are produced into `head % RECORDER_SLOT_COUNT` and consumed from
+    // `tail % RECORDER_SLOT_COUNT`, both counters only ever grow.
+    uint64_t head;
+    uint64_t tail;
+    bool stopping;
+    std::atomic<bool> failed;
+    std::mutex lock;
+    std::condition_variable slotsReady;
+    std::condition_variable slotsFree;
+    std::thread writer;
+
+    uint8_t* slotAt(uint64_t frameIdx) const {
+        return &slots[(frameIdx % RECORDER_SLOT_COUNT) * frameBytes];
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> guard{lock};
+        while (true) {
+            slotsReady.wait(guard, [this] { return stopping || head != tail; });
+            if (head == tail) {
+                // Stopping and nothing left to flush.
+                break;
+            }
+
+            // Flush all contiguous ready slots up to the end of the ring at once.
+            uint64_t firstSlot = tail % RECORDER_SLOT_COUNT;
+            uint64_t count = std::min(head - tail, RECORDER_SLOT_COUNT - firstSlot);
+            guard.unlock();
+
+            if (!failed.load(std::memory_order_relaxed)) {
+                size_t bytes = count * frameBytes;
+                if (std::fwrite(slotAt(tail), 1, bytes, output) != bytes) {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            guard.lock();
+            tail += count;
+            slotsFree.notify_one();
+        }
+    }
+
+  public:
+    FrameRecorder(unsigned int cols, unsigned int rows, FrameFormat format, bool deltaEncode)
+        : cols{cols},
+          rows{rows},
+          format{format},
+          deltaEncode{deltaEncode},
+          frameBytes{format == FrameFormat::Bit1 ? ((cols + 7) / 8) * (size_t)rows : (size_t)cols * rows},
+          output{nullptr},
+          ownsOutput{false},
+          head{0},
+          tail{0},
+          stopping{false},
+          failed{false} {}
+
+    ~FrameRecorder() {
+        close();
+    }
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    // Opens the output and starts the writer thread. The path "-" stands for the standard output,
+    // which is how the stream is piped into an encoder.
+    bool open(const char* path) {
+        if (std::strcmp(path, "-") == 0) {
+            output = stdout;
+            ownsOutput = false;
+        } else {
+            output = std::fopen(path, "wb");
+            ownsOutput = true;
+        }
+        if (output == nullptr) {
+            std::cerr << "Couldn't open the recording output " << path << ": " << std::strerror(errno)
+                      << std::endl;
+            return false;
+        }
+
+        // The writer thread already batches whole runs of frames, stdio buffering would only add a copy.
+        std::setvbuf(output, nullptr, _IONBF, 0);
+
+        slots.reset(new uint8_t[RECORDER_SLOT_COUNT * frameBytes]);
+        if (deltaEncode) {
+            previousFrame.reset(new uint8_t[frameBytes]());
+        }
+
+        writer = std::thread(&FrameRecorder::writerLoop, this);
+        return true;
+    }
+
+    // Flushes every queued frame and closes the output.
+    void close() {
+        if (output == nullptr) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            stopping = true;
+        }
+        slotsReady.notify_one();
+        writer.join();
+
+        if (failed.load(std::memory_order_relaxed)) {
+            std::cerr << "Some frames couldn't be written to the recording output." << std::endl;
+        }
+        if (ownsOutput) {
+            std::fclose(output);
+        } else {
+            std::fflush(output);
+        }
+        output = nullptr;
+    }
+
+    bool isOpen() const {
+        return output != nullptr;
+    }
+
+    // Queues a new frame, where `isAlive(cellIdx)` tells the state of each cell in row-major order.
+    template <typename IsAlive>
+    void record(IsAlive isAlive) {
+        {
+            std::unique_lock<std::mutex> guard{lock};
+            slotsFree.wait(guard, [this] { return head - tail < RECORDER_SLOT_COUNT; });
+        }
+
+        // The slot at `head` is exclusively ours until it gets published below.
+        uint8_t* frame = slotAt(head);
+        if (format == FrameFormat::Bit1) {
+            size_t rowBytes = (cols + 7) / 8;
+            std::memset(frame, 0, frameBytes);
+            for (unsigned int y = 0; y < rows; y++) {
+                uint8_t* row = frame + y * rowBytes;
+                for (unsigned int x = 0; x < cols; x++) {
+                    row[x / 8] |= (uint8_t)((unsigned int)isAlive(y * cols + x) << (7 - x % 8));
+                }
+            }
+        } else {
+            for (size_t cellIdx = 0; cellIdx < frameBytes; cellIdx++) {
+                frame[cellIdx] = (uint8_t)(0 - (uint8_t)isAlive(cellIdx));
+            }
+        }
+
+        if (deltaEncode) {
+            for (size_t byteIdx = 0; byteIdx < frameBytes; byteIdx++) {
+                uint8_t current = frame[byteIdx];
+                frame[byteIdx] ^= previousFrame[byteIdx];
+                previousFrame[byteIdx] = current;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            head++;
+        }
+        slotsReady.notify_one();
+    }
+};
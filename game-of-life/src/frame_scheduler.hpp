@@ -0,0 +1,146 @@
+#pragma once
+
+#include <SDL2/SDL_timer.h>
+#include <algorithm>
+#include <cstdint>
+
+// How far behind the target generation rate we may fall before giving up on it.
+const double SCHEDULER_MAX_BACKLOG_SECONDS = 0.25;
+
+// Paces the generations and the frames of the main loop to independent target rates.
+//
+// Deadlines are absolute, so the time spent stepping and rendering is subtracted from the sleep
+// instead of being added to it. When the generation rate can't be met the scheduler switches to a
+// max-throughput mode that steps as many generations as fit between two frames, and goes back to
+// pacing once the measured rate exceeds the target again. A target of zero generations per second
+// means running at max throughput all the time.
+class FrameScheduler {
+  private:
+    uint64_t ticksPerSecond;
+    double targetGenerationsPerSecond;
+    uint64_t generationPeriod;
+    uint64_t framePeriod;
+    uint64_t maxBacklogGenerations;
+
+    uint64_t nextGenerationTick;
+    uint64_t nextFrameTick;
+    uint64_t lastFrameTick;
+    uint64_t generationsSinceLastFrame;
+    bool maxThroughput;
+    bool paused;
+
+  public:
+    FrameScheduler(double generationsPerSecond, double framesPerSecond)
+        : ticksPerSecond{SDL_GetPerformanceFrequency()},
+          targetGenerationsPerSecond{generationsPerSecond},
+          generationPeriod{generationsPerSecond > 0 ? std::max<uint64_t>((uint64_t)(ticksPerSecond / generationsPerSecond), 1) : 0},
+          framePeriod{(uint64_t)(ticksPerSecond / framesPerSecond)},
+          maxBacklogGenerations{(uint64_t)(generationsPerSecond * SCHEDULER_MAX_BACKLOG_SECONDS) + 1},
+          nextGenerationTick{SDL_GetPerformanceCounter()},
+          nextFrameTick{nextGenerationTick},
+          lastFrameTick{nextGenerationTick},
+          generationsSinceLastFrame{0},
+          maxThroughput{generationsPerSecond <= 0},
+          paused{false} {}
+
+    bool isMaxThroughput() const {
+        return maxThroughput;
+    }
+
+    void setPaused(bool isPaused) {
+        if (paused && !isPaused) {
+            // Don't try to catch up with the generations that were due while paused.
+            nextGenerationTick = SDL_GetPerformanceCounter();
+        }
+        paused = isPaused;
+    }
+
+    // Runs as many generations as are due, where `step()` runs one and returns false on failure.
+    template <typename Step>
+    bool runGenerations(Step step) {
+        if (paused) {
+            return true;
+        }
+
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (maxThroughput) {
+            // Step until the next frame is due, but always make some progress.
+            do {
+                if (!step()) {
+                    return false;
+                }
+                generationsSinceLastFrame++;
+                now = SDL_GetPerformanceCounter();
+            } while (now < nextFrameTick);
+            return true;
+        }
+
+        if (now < nextGenerationTick) {
+            return true;
+        }
+        uint64_t due = (now - nextGenerationTick) / generationPeriod + 1;
+        if (due > maxBacklogGenerations) {
+            maxThroughput = true;
+        }
+        for (uint64_t generation = 0; generation < due; generation++) {
+            if (!step()) {
+                return false;
+            }
+            generationsSinceLastFrame++;
+            nextGenerationTick += generationPeriod;
+
+            // Catch up with the rest after the frame is rendered.
+            if (SDL_GetPerformanceCounter() >= nextFrameTick) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Tells whether a frame should be rendered now, in which case it's accounted as rendered.
+    bool frameDue() {
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now < nextFrameTick) {
+            return false;
+        }
+
+        if (maxThroughput && targetGenerationsPerSecond > 0 && now > lastFrameTick) {
+            double measuredRate = (double)generationsSinceLastFrame * ticksPerSecond / (double)(now - lastFrameTick);
+            if (measuredRate > targetGenerationsPerSecond) {
+                maxThroughput = false;
+                nextGenerationTick = now;
+            }
+        }
+        lastFrameTick = now;
+        generationsSinceLastFrame = 0;
+
+        nextFrameTick += framePeriod;
+        if (nextFrameTick <= now) {
+            // We're late by more than a frame, skip the missed ones.
+            nextFrameTick = now + framePeriod;
+        }
+        return true;
+    }
+
+    // Sleeps until the next generation or frame is due, whichever comes first.
+    void waitForNextDeadline() const {
+        if (maxThroughput && !paused) {
+            return;
+        }
+
+        uint64_t deadline = nextFrameTick;
+        if (!paused && nextGenerationTick < deadline) {
+            deadline = nextGenerationTick;
+        }
+
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (deadline > now) {
+            // SDL_Delay has a millisecond granularity, sleeping less than needed is fine since the
+            // loop will simply check the deadlines again.
+            uint64_t millis = (deadline - now) * 1000 / ticksPerSecond;
+            if (millis > 0) {
+                SDL_Delay((uint32_t)millis);
+            }
+        }
+    }
+};
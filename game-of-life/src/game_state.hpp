@@ -0,0 +1,231 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_render.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+const int COLOR_ALIVE[4] = {255, 255, 255, 0};
+const int COLOR_DEAD[4] = {0, 0, 0, 0};
+
+const unsigned int CELL_SIZE = 4;
+
+const float LIKELIHOOD_STARTS_DEAD = 0.6;
+
+// Maps an activity count to an ARGB8888 colour going from black through red and yellow to white.
+// Counts go through a square root first so that the rarely active cells are still visible.
+struct HeatmapPalette {
+    uint32_t colors[256];
+
+    HeatmapPalette() : colors{} {
+        for (unsigned int count = 0; count < 256; count++) {
+            float heat = std::sqrt(count / 255.0f) * 3.0f;
+            uint32_t red = (uint32_t)(255.0f * std::min(heat, 1.0f));
+            uint32_t green = (uint32_t)(255.0f * std::min(std::max(heat - 1.0f, 0.0f), 1.0f));
+            uint32_t blue = (uint32_t)(255.0f * std::max(heat - 2.0f, 0.0f));
+            colors[count] = 0xFF000000 | (red << 16) | (green << 8) | blue;
+        }
+    }
+};
+
+const HeatmapPalette HEATMAP_PALETTE{};
+
+inline float randf() {
+    return (float)(std::rand() / (float)RAND_MAX);
+}
+
+class Cell {
+  private:
+    bool alive;
+    SDL_Rect rect;
+
+  public:
+    Cell() : alive{false} {}
+
+    Cell(unsigned int x_pos, unsigned int y_pos, bool alive) : alive{alive} {
+        rect.x = x_pos;
+        rect.y = y_pos;
+        rect.h = CELL_SIZE;
+        rect.w = CELL_SIZE;
+    }
+
+    bool isAlive() const {
+        return alive;
+    }
+
+    void setLife(bool life) {
+        alive = life;
+    }
+
+    void draw(SDL_Renderer* renderer) const {
+        if (alive) {
+            SDL_SetRenderDrawColor(
+                renderer, COLOR_ALIVE[0], COLOR_ALIVE[1], COLOR_ALIVE[2], COLOR_ALIVE[3]);
+        } else {
+            SDL_SetRenderDrawColor(
+                renderer, COLOR_DEAD[0], COLOR_DEAD[1], COLOR_DEAD[2], COLOR_DEAD[3]);
+        }
+        SDL_RenderFillRect(renderer, &rect);
+    }
+};
+
+template <unsigned int cols, unsigned int rows>
+class GameState {
+  private:
+    unsigned int gameSize;
+    Cell state[cols * rows];
+    bool nextAlive[cols * rows];
+
+    // Saturating count of how many times each cell changed state, only kept up to date while
+    // `trackActivity` is set.
+    bool trackActivity;
+    uint8_t activity[cols * rows];
+
+    // Sets a cell to its next state, counting the change towards the cell's activity.
+    template <bool countActivity>
+    void updateCell(unsigned int cellIdx, bool alive) {
+        if (countActivity) {
+            uint8_t changed = (uint8_t)(state[cellIdx].isAlive() != alive);
+            activity[cellIdx] += changed & (uint8_t)(activity[cellIdx] != UINT8_MAX);
+        }
+        state[cellIdx].setLife(alive);
+    }
+
+    template <bool countActivity>
+    void updateFromPacked(const uint64_t* words) {
+        for (unsigned int y = 0; y < rows; y++) {
+            const uint64_t* row = words + y * packedRowWords;
+            for (unsigned int x = 0; x < cols; x++) {
+                updateCell<countActivity>(x + y * cols, (row[x / 64] >> (x % 64)) & 1);
+            }
+        }
+    }
+
+    template <bool countActivity>
+    void updateFromNext() {
+        for (unsigned int cellIdx = 0; cellIdx < gameSize; cellIdx++) {
+            updateCell<countActivity>(cellIdx, nextAlive[cellIdx]);
+        }
+    }
+
+  public:
+    // Packed layout used to export the board: each row starts at a new 64-bit word and cell `x` of a
+    // row lives in the bit `x % 64` of the word `x / 64`.
+    static constexpr size_t packedRowWords = (cols + 63) / 64;
+    static constexpr size_t packedWords = packedRowWords * rows;
+
+    GameState() : gameSize{cols * rows}, trackActivity{false}, activity{} {
+        for (size_t i = 0; i < gameSize; i++) {
+            bool alive = randf() >= LIKELIHOOD_STARTS_DEAD;
+            state[i] =
+                Cell((i % cols) * CELL_SIZE, (i / cols) * CELL_SIZE, alive);
+        }
+    };
+
+    bool isCellAlive(unsigned int cellIdx) const {
+        return state[cellIdx].isAlive();
+    }
+
+    void packCells(uint64_t* words) const {
+        std::memset(words, 0, packedWords * sizeof(uint64_t));
+        for (unsigned int y = 0; y < rows; y++) {
+            uint64_t* row = words + y * packedRowWords;
+            for (unsigned int x = 0; x < cols; x++) {
+                row[x / 64] |= (uint64_t)state[x + y * cols].isAlive() << (x % 64);
+            }
+        }
+    }
+
+    // Replaces the board with the packed one. When the packed board is the next generation computed
+    // elsewhere, `isStep` makes the changes count towards the activity of the cells.
+    void unpackCells(const uint64_t* words, bool isStep = false) {
+        if (isStep && trackActivity) {
+            updateFromPacked<true>(words);
+        } else {
+            updateFromPacked<false>(words);
+        }
+    }
+
+    void setActivityTracking(bool enabled) {
+        trackActivity = enabled;
+    }
+
+    // Paints the activity of each cell as one texel of a streaming ARGB8888 texture of `cols` by
+    // `rows` texels, then stretches it over the whole render target.
+    void drawActivity(SDL_Renderer* renderer, SDL_Texture* texture) const {
+        void* pixels;
+        int pitch;
+        if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) != 0) {
+            return;
+        }
+        for (unsigned int y = 0; y < rows; y++) {
+            uint32_t* texels = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) + y * pitch);
+            for (unsigned int x = 0; x < cols; x++) {
+                texels[x] = HEATMAP_PALETTE.colors[activity[x + y * cols]];
+            }
+        }
+        SDL_UnlockTexture(texture);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    }
+
+    void draw(SDL_Renderer* renderer) {
+        for (Cell& cell : state) {
+            cell.draw(renderer);
+        }
+    }
+
+    // Count the number of direct neighbours that are alive.
+    unsigned int neighbourCount(unsigned int cellIdx) {
+        int xIdx = cellIdx % cols;
+        int yIdx = cellIdx / cols;
+
+        unsigned int count{};
+        for (int xShift = -1; xShift <= 1; xShift++) {
+            int xNbhd = xIdx + xShift;
+
+            // Check if we got outside the grid.
+            if (xNbhd < 0 || (int)cols <= xNbhd) {
+                continue;
+            }
+
+            for (int yShift = -1; yShift <= 1; yShift++) {
+                if (xShift == 0 && yShift == 0) {
+                    continue;
+                }
+                int yNbhd = yIdx + yShift;
+
+                // Check if we got outside the grid.
+                if (yNbhd < 0 || (int)rows <= yNbhd) {
+                    continue;
+                }
+
+                count += (unsigned int)state[xNbhd + yNbhd * cols].isAlive();
+            }
+        }
+        return count;
+    }
+
+    void nextIteration() {
+        // Decide the fate of every cell before touching any of them, so that all cells are updated
+        // from the same generation.
+        for (unsigned int cellIdx = 0; cellIdx < gameSize; cellIdx++) {
+            unsigned int numNeighbours = neighbourCount(cellIdx);
+            if (state[cellIdx].isAlive()) {
+                // Death by underpopulation or overpopulation.
+                nextAlive[cellIdx] = numNeighbours == 2 || numNeighbours == 3;
+            } else {
+                // Reproduction.
+                nextAlive[cellIdx] = numNeighbours == 3;
+            }
+        }
+
+        if (trackActivity) {
+            updateFromNext<true>();
+        } else {
+            updateFromNext<false>();
+        }
+    }
+};
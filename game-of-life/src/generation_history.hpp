@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Bounded history of the past generations of a board packed as 64-bit words.
+//
+// Every `keyframeInterval` generations the whole board is stored as a keyframe, the generations in
+// between are stored as the XOR of the board with its predecessor. Since most of the board doesn't
+// change from one generation to the next, those deltas are mostly zero words and get compressed with
+// a run-length encoding where each token is a header word, holding the number of zero words to skip
+// in its upper half and the number of literal words that follow in its lower half, followed by the
+// literal words themselves.
+//
+// Records live in a fixed arena used as a ring buffer, when a new record doesn't fit the oldest
+// ones are evicted. Reconstructing any generation costs at most `keyframeInterval` delta decodes
+// since we either walk forward from the keyframe before it or backward from the newest generation.
+class GenerationHistory {
+  private:
+    struct Record {
+        uint64_t generation;
+        size_t offset;
+        size_t length;
+        bool isKeyframe;
+    };
+
+    size_t wordCount;
+    unsigned int keyframeInterval;
+
+    // Ring buffer of encoded records.
+    std::unique_ptr<uint64_t[]> arena;
+    size_t arenaWords;
+    size_t writeOffset;
+
+    // Ring buffer of record descriptors, oldest at `firstRecord`.
+    std::unique_ptr<Record[]> records;
+    size_t maxRecords;
+    size_t firstRecord;
+    size_t recordCount;
+
+    // The newest generation, needed to compute the next delta.
+    std::unique_ptr<uint64_t[]> newest;
+    // Scratch space for encoding a delta, fits the worst-case encoding of a full board.
+    std::unique_ptr<uint64_t[]> scratch;
+    uint64_t nextGeneration;
+
+    Record& recordAt(size_t idx) const {
+        return records[(firstRecord + idx) % maxRecords];
+    }
+
+    void evictOldest() {
+        firstRecord = (firstRecord + 1) % maxRecords;
+        recordCount--;
+    }
+
+    // Only keep records that can be reconstructed, that is, everything from the oldest keyframe on.
+    void evictUntilKeyframe() {
+        while (recordCount > 0 && !recordAt(0).isKeyframe) {
+            evictOldest();
+        }
+    }
+
+    size_t encodeDelta(const uint64_t* words) {
+        size_t length = 0;
+        size_t wordIdx = 0;
+        while (wordIdx < wordCount) {
+            size_t zeroRun = 0;
+            while (wordIdx < wordCount && (words[wordIdx] ^ newest[wordIdx]) == 0) {
+                zeroRun++;
+                wordIdx++;
+            }
+
+            size_t header = length++;
+            size_t literalCount = 0;
+            while (wordIdx < wordCount && (words[wordIdx] ^ newest[wordIdx]) != 0) {
+                scratch[length++] = words[wordIdx] ^ newest[wordIdx];
+                literalCount++;
+                wordIdx++;
+            }
+            scratch[header] = ((uint64_t)zeroRun << 32) | literalCount;
+        }
+        return length;
+    }
+
+    void applyDelta(const Record& record, uint64_t* words) const {
+        const uint64_t* data = &arena[record.offset];
+        size_t wordIdx = 0;
+        size_t dataIdx = 0;
+        while (dataIdx < record.length) {
+            uint64_t header = data[dataIdx++];
+            wordIdx += header >> 32;
+            for (size_t literalCount = header & 0xFFFFFFFF; literalCount > 0; literalCount--) {
+                words[wordIdx++] ^= data[dataIdx++];
+            }
+        }
+    }
+
+    // Finds a contiguous region of the arena for a new record, evicting old ones as needed.
+    size_t reserve(size_t length) {
+        if (recordCount == maxRecords) {
+            evictOldest();
+            evictUntilKeyframe();
+        }
+        if (recordCount == 0) {
+            writeOffset = 0;
+        }
+
+        if (writeOffset + length > arenaWords) {
+            // Whatever lives past the write offset is the oldest data, drop it and wrap around.
+            while (recordCount > 0 && recordAt(0).offset >= writeOffset) {
+                evictOldest();
+            }
+            writeOffset = 0;
+        }
+        while (recordCount > 0 && recordAt(0).offset >= writeOffset && recordAt(0).offset < writeOffset + length) {
+            evictOldest();
+        }
+        evictUntilKeyframe();
+
+        size_t offset = writeOffset;
+        writeOffset += length;
+        return offset;
+    }
+
+  public:
+    // The budget accounts for the encoded records only, it has to fit at least two keyframes.
+    GenerationHistory(size_t wordCount, size_t budgetBytes, unsigned int keyframeInterval, size_t maxRecords)
+        : wordCount{wordCount},
+          keyframeInterval{keyframeInterval},
+          arena{new uint64_t[budgetBytes / sizeof(uint64_t)]},
+          arenaWords{budgetBytes / sizeof(uint64_t)},
+          writeOffset{0},
+          records{new Record[maxRecords]},
+          maxRecords{maxRecords},
+          firstRecord{0},
+          recordCount{0},
+          newest{new uint64_t[wordCount]()},
+          scratch{new uint64_t[2 * wordCount + 2]},
+          nextGeneration{0} {
+        assert(arenaWords >= 2 * wordCount);
+        assert(keyframeInterval > 0 && maxRecords > keyframeInterval);
+    }
+
+    // Records the board of the next generation.
+    void push(const uint64_t* words) {
+        bool isKeyframe = (nextGeneration % keyframeInterval == 0) || (recordCount == 0);
+        size_t length = wordCount;
+        if (!isKeyframe) {
+            length = encodeDelta(words);
+            // Deltas that don't compress are more expensive to decode than the whole board.
+            isKeyframe = length >= wordCount;
+        }
+
+        size_t offset = reserve(isKeyframe ? wordCount : length);
+        if (!isKeyframe && recordCount == 0) {
+            // Making room evicted the base of this delta, so it has to become a keyframe.
+            isKeyframe = true;
+            offset = reserve(wordCount);
+        }
+        if (isKeyframe) {
+            length = wordCount;
+            std::memcpy(&arena[offset], words, length * sizeof(uint64_t));
+        } else {
+            std::memcpy(&arena[offset], scratch.get(), length * sizeof(uint64_t));
+        }
+
+        Record& record = records[(firstRecord + recordCount) % maxRecords];
+        record.generation = nextGeneration;
+        record.offset = offset;
+        record.length = length;
+        record.isKeyframe = isKeyframe;
+        recordCount++;
+
+        std::memcpy(newest.get(), words, wordCount * sizeof(uint64_t));
+        nextGeneration++;
+    }
+
+    // Number of generations we can currently step back.
+    size_t available() const {
+        if (recordCount == 0) {
+            return 0;
+        }
+        return (size_t)(recordAt(recordCount - 1).generation - recordAt(0).generation);
+    }
+
+    // Restores into `words` the board as it was `steps` generations before the newest one, which then
+    // becomes the newest generation of the history.
+    bool rewind(size_t steps, uint64_t* words) {
+        if (steps == 0 || steps > available()) {
+            return false;
+        }
+
+        size_t target = recordCount - 1 - steps;
+
+        // Records are one per generation, so the nearest keyframe at or before the target is found
+        // by walking back at most a keyframe interval.
+        size_t keyframe = target;
+        while (!recordAt(keyframe).isKeyframe) {
+            keyframe--;
+        }
+        size_t nextKeyframe = target + 1;
+        while (nextKeyframe < recordCount && !recordAt(nextKeyframe).isKeyframe) {
+            nextKeyframe++;
+        }
+
+        if (nextKeyframe == recordCount && recordCount - 1 - target < target - keyframe) {
+            // Undo the deltas from the newest generation down to the target.
+            std::memcpy(words, newest.get(), wordCount * sizeof(uint64_t));
+            for (size_t recordIdx = recordCount - 1; recordIdx > target; recordIdx--) {
+                applyDelta(recordAt(recordIdx), words);
+            }
+        } else {
+            // Redo the deltas from the keyframe up to the target.
+            const Record& base = recordAt(keyframe);
+            std::memcpy(words, &arena[base.offset], wordCount * sizeof(uint64_t));
+            for (size_t recordIdx = keyframe + 1; recordIdx <= target; recordIdx++) {
+                applyDelta(recordAt(recordIdx), words);
+            }
+        }
+
+        // Forget about the generations after the target.
+        const Record& last = recordAt(target);
+        recordCount = target + 1;
+        writeOffset = last.offset + last.length;
+        nextGeneration = last.generation + 1;
+        std::memcpy(newest.get(), words, wordCount * sizeof(uint64_t));
+        return true;
+    }
+};
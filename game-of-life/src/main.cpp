@@ -2,131 +2,166 @@
 #include <SDL2/SDL_events.h>
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_video.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-
-const int COLOR_ALIVE[4] = {255, 255, 255, 0};
-const int COLOR_DEAD[4] = {0, 0, 0, 0};
+#include <memory>
+#include "frame_recorder.hpp"
+#include "frame_scheduler.hpp"
+#include "game_state.hpp"
+#include "generation_history.hpp"
+#include "mapped_board.hpp"
+#ifdef __linux__
+// The workers rely on futexes and Linux's NUMA and scheduling system calls.
+#include "striped_board.hpp"
+#endif
 
 const unsigned int WINDOW_WIDTH = 400;
 const unsigned int WINDOW_HEIGHT = 400;
-const unsigned int CELL_SIZE = 4;
-
-const float LIKELIHOOD_STARTS_DEAD = 0.6;
-
-const unsigned int DELAY_REFRESH_MILLIS = 60;
-
-float randf() {
-    return (float)(std::rand() / (float)RAND_MAX);
-}
 
-class Cell {
-  private:
-    bool alive;
-    SDL_Rect rect;
+const double DEFAULT_GENERATIONS_PER_SECOND = 1000.0 / 60.0;
+const double DEFAULT_FRAMES_PER_SECOND = 60.0;
 
-  public:
-    Cell() : alive{false} {}
+const size_t HISTORY_DEFAULT_BUDGET_MIB = 64;
+const unsigned int HISTORY_KEYFRAME_INTERVAL = 64;
+const size_t HISTORY_MAX_GENERATIONS = 1 << 16;
+const size_t REWIND_FAST_STEPS = 10;
 
-    Cell(unsigned int x_pos, unsigned int y_pos, bool alive) : alive{alive} {
-        rect.x = x_pos;
-        rect.y = y_pos;
-        rect.h = CELL_SIZE;
-        rect.w = CELL_SIZE;
-    }
+struct Options {
+    const char* recordPath = nullptr;
+    FrameFormat recordFormat = FrameFormat::Byte8;
+    bool recordDelta = false;
+    size_t historyMib = HISTORY_DEFAULT_BUDGET_MIB;
+    unsigned int workers = 0;
+    bool heatmap = false;
+    double generationsPerSecond = DEFAULT_GENERATIONS_PER_SECOND;
+    double framesPerSecond = DEFAULT_FRAMES_PER_SECOND;
+    const char* mappedPath = nullptr;
+    uint64_t mappedCols = 0;
+    uint64_t mappedRows = 0;
+    unsigned int generations = 1;
+};
 
-    bool isAlive() const {
-        return alive;
-    }
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --record PATH         Write every generation as a raw frame stream to PATH (- for stdout).\n"
+              << "  --record-format 1|8   Bits per cell of the recorded frames (default: 8).\n"
+              << "  --record-delta        XOR each recorded frame with the previous one.\n"
+              << "  --history-mib N       Memory budget of the rewind history (default: 64, 0 disables it).\n"
+#ifdef __linux__
+              << "  --workers N           Step the board in N worker processes sharing memory.\n"
+#endif
+              << "  --gps N               Target generations per second (default: 16.7, 0 runs as fast as possible).\n"
+              << "  --fps N               Target frames per second (default: 60).\n"
+              << "  --heatmap             Start showing the activity heatmap.\n"
+              << "  --mapped PATH         Step the board stored in the file PATH without a window.\n"
+              << "  --mapped-size WxH     Size of the board when PATH doesn't exist yet.\n"
+              << "  --generations N       Generations to step the mapped board by (default: 1).\n"
+              << "Controls: space pauses, left rewinds (shift rewinds faster), right steps while paused, h toggles the heatmap.\n";
+}
 
-    void setLife(bool life) {
-        alive = life;
-    }
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        const char* arg = argv[argIdx];
+        bool hasValue = argIdx + 1 < argc;
 
-    void draw(SDL_Renderer* renderer) const {
-        if (alive) {
-            SDL_SetRenderDrawColor(
-                renderer, COLOR_ALIVE[0], COLOR_ALIVE[1], COLOR_ALIVE[2], COLOR_ALIVE[3]);
+        if (std::strcmp(arg, "--record") == 0 && hasValue) {
+            options.recordPath = argv[++argIdx];
+        } else if (std::strcmp(arg, "--record-format") == 0 && hasValue) {
+            int bits = std::atoi(argv[++argIdx]);
+            if (bits != 1 && bits != 8) {
+                std::cerr << "Invalid frame format: " << bits << " bits per cell." << std::endl;
+                return false;
+            }
+            options.recordFormat = (bits == 1) ? FrameFormat::Bit1 : FrameFormat::Byte8;
+        } else if (std::strcmp(arg, "--record-delta") == 0) {
+            options.recordDelta = true;
+        } else if (std::strcmp(arg, "--history-mib") == 0 && hasValue) {
+            options.historyMib = (size_t)std::strtoul(argv[++argIdx], nullptr, 10);
+        } else if (std::strcmp(arg, "--workers") == 0 && hasValue) {
+#ifdef __linux__
+            options.workers = (unsigned int)std::strtoul(argv[++argIdx], nullptr, 10);
+#else
+            std::cerr << "Worker processes are only supported on Linux." << std::endl;
+            return false;
+#endif
+        } else if (std::strcmp(arg, "--gps") == 0 && hasValue) {
+            options.generationsPerSecond = std::atof(argv[++argIdx]);
+        } else if (std::strcmp(arg, "--fps") == 0 && hasValue) {
+            options.framesPerSecond = std::atof(argv[++argIdx]);
+            if (options.framesPerSecond <= 0) {
+                std::cerr << "The target frames per second must be positive." << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--mapped") == 0 && hasValue) {
+            options.mappedPath = argv[++argIdx];
+        } else if (std::strcmp(arg, "--mapped-size") == 0 && hasValue) {
+            char* separator = nullptr;
+            options.mappedCols = std::strtoull(argv[++argIdx], &separator, 10);
+            if (*separator != 'x') {
+                std::cerr << "Invalid board size: " << argv[argIdx] << std::endl;
+                return false;
+            }
+            options.mappedRows = std::strtoull(separator + 1, nullptr, 10);
+        } else if (std::strcmp(arg, "--generations") == 0 && hasValue) {
+            options.generations = (unsigned int)std::strtoul(argv[++argIdx], nullptr, 10);
+        } else if (std::strcmp(arg, "--heatmap") == 0) {
+            options.heatmap = true;
         } else {
-            SDL_SetRenderDrawColor(
-                renderer, COLOR_DEAD[0], COLOR_DEAD[1], COLOR_DEAD[2], COLOR_DEAD[3]);
+            printUsage(argv[0]);
+            return false;
         }
-        SDL_RenderFillRect(renderer, &rect);
     }
-};
-
-template <unsigned int cols, unsigned int rows>
-class GameState {
-  private:
-    unsigned int gameSize;
-    Cell state[cols * rows];
-
-  public:
-    GameState() : gameSize{cols * rows} {
-        for (size_t i = 0; i < gameSize; i++) {
-            bool alive = randf() >= LIKELIHOOD_STARTS_DEAD;
-            state[i] =
-                Cell((i * CELL_SIZE) % WINDOW_WIDTH, (i / cols) * CELL_SIZE, alive);
-        }
-    };
+    return true;
+}
 
-    void draw(SDL_Renderer* renderer) {
-        for (Cell& cell : state) {
-            cell.draw(renderer);
-        }
+// Steps a board too large to be displayed, straight from its file.
+int runMappedBoard(const Options& options) {
+    MappedBoard board{};
+    if (!board.open(options.mappedPath, options.mappedCols, options.mappedRows)) {
+        return -1;
     }
 
-    // Count the number of direct neighbours that are alive.
-    unsigned int neighbourCount(unsigned int cellIdx) {
-        int xIdx = cellIdx % cols;
-        int yIdx = cellIdx / cols;
-
-        unsigned int count{};
-        for (int xShift = -1; xShift <= 1; xShift++) {
-            int xNbhd = xIdx + xShift;
-
-            // Check if we got outside the grid.
-            if (xNbhd < 0 || (int)cols <= xNbhd) {
-                continue;
-            }
+    auto start = std::chrono::steady_clock::now();
+    board.step(options.generations);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-            for (int yShift = -1; yShift <= 1; yShift++) {
-                if (xShift == 0 && yShift == 0) {
-                    continue;
-                }
-                int yNbhd = yIdx + yShift;
+    double cellUpdates = (double)board.getCols() * board.getRows() * options.generations;
+    std::cout << "Stepped the " << board.getCols() << "x" << board.getRows() << " board to generation "
+              << board.generation() << " in " << seconds << " s (" << cellUpdates / seconds
+              << " cells/s)." << std::endl;
+    return 0;
+}
 
-                // Check if we got outside the grid.
-                if (yNbhd < 0 || (int)rows <= yNbhd) {
-                    continue;
-                }
+int main(int argc, char** argv) {
+    Options options{};
+    if (!parseOptions(argc, argv, options)) {
+        return -1;
+    }
 
-                count += (unsigned int)state[xNbhd + yNbhd * cols].isAlive();
-            }
-        }
-        return count;
+    if (options.mappedPath != nullptr) {
+        return runMappedBoard(options);
     }
 
-    void nextIteration() {
-        for (unsigned int cellIdx = 0; cellIdx < gameSize; cellIdx++) {
-            unsigned int numNeighbours = neighbourCount(cellIdx);
-            if (state[cellIdx].isAlive()) {
-                // Death by underpopulation or overpopulation.
-                if (numNeighbours < 2 || numNeighbours > 3) {
-                    state[cellIdx].setLife(false);
-                }
-            } else {
-                // Reproduction.
-                if (numNeighbours == 3) {
-                    state[cellIdx].setLife(true);
-                }
-            }
+    const unsigned int cols = WINDOW_WIDTH / CELL_SIZE;
+    const unsigned int rows = WINDOW_HEIGHT / CELL_SIZE;
+
+#ifdef __linux__
+    // The workers are forked, so they have to be spawned before SDL starts any thread.
+    std::unique_ptr<StripedBoard> striped;
+    if (options.workers > 0) {
+        striped.reset(new StripedBoard{cols, rows, options.workers});
+        if (!striped->start()) {
+            return -1;
         }
     }
-};
+#endif
 
-int main() {
     if (SDL_VideoInit(nullptr) != 0) {
-        std::cout << "Couldn't initialise SDL video subsystem: " << SDL_GetError()
+        std::cerr << "Couldn't initialise SDL video subsystem: " << SDL_GetError()
                   << std::endl;
         return -1;
     }
@@ -136,35 +171,159 @@ int main() {
     SDL_CreateWindowAndRenderer(WINDOW_WIDTH, WINDOW_HEIGHT, 0, &window, &renderer);
 
     if (window == nullptr) {
-        std::cout << "Couldn't create a new window: " << SDL_GetError() << std::endl;
+        std::cerr << "Couldn't create a new window: " << SDL_GetError() << std::endl;
         return -1;
     }
     if (renderer == nullptr) {
-        std::cout << "Couldn't create a new renderer: " << SDL_GetError() << std::endl;
+        std::cerr << "Couldn't create a new renderer: " << SDL_GetError() << std::endl;
+        return -1;
+    }
+
+    GameState<cols, rows> game{};
+
+    // Activity is only tracked once the heatmap has been shown, so that it costs nothing otherwise.
+    SDL_Texture* heatmapTexture =
+        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, cols, rows);
+    if (heatmapTexture == nullptr) {
+        std::cerr << "Couldn't create the heatmap texture: " << SDL_GetError() << std::endl;
+        return -1;
+    }
+    bool showHeatmap = options.heatmap;
+    game.setActivityTracking(showHeatmap);
+
+    FrameRecorder recorder{cols, rows, options.recordFormat, options.recordDelta};
+    if (options.recordPath != nullptr && !recorder.open(options.recordPath)) {
+        return -1;
+    }
+
+    // The history needs room for at least a couple of keyframes to be of any use.
+    size_t historyBudget = options.historyMib << 20;
+    bool historyEnabled = historyBudget >= 2 * game.packedWords * sizeof(uint64_t);
+    std::unique_ptr<uint64_t[]> packedBoard{new uint64_t[game.packedWords]};
+    std::unique_ptr<GenerationHistory> history;
+    game.packCells(packedBoard.get());
+    if (historyEnabled) {
+        history.reset(new GenerationHistory{
+            game.packedWords, historyBudget, HISTORY_KEYFRAME_INTERVAL, HISTORY_MAX_GENERATIONS});
+        history->push(packedBoard.get());
+    }
+#ifdef __linux__
+    if (striped && !striped->load(packedBoard.get())) {
+        std::cerr << "Couldn't load the board into the workers." << std::endl;
         return -1;
     }
+#endif
+
+    // Returns false if the board can't be stepped anymore.
+    auto advance = [&]() {
+        bool stepped = false;
+#ifdef __linux__
+        if (striped) {
+            if (!striped->step(1) || !striped->store(packedBoard.get())) {
+                return false;
+            }
+            game.unpackCells(packedBoard.get(), true);
+            stepped = true;
+        }
+#endif
+        if (!stepped) {
+            game.nextIteration();
+            if (historyEnabled) {
+                game.packCells(packedBoard.get());
+            }
+        }
+
+        if (historyEnabled) {
+            history->push(packedBoard.get());
+        }
+        if (recorder.isOpen()) {
+            recorder.record([&game](unsigned int cellIdx) { return game.isCellAlive(cellIdx); });
+        }
+        return true;
+    };
 
-    GameState<WINDOW_HEIGHT / CELL_SIZE, WINDOW_WIDTH / CELL_SIZE> game{};
+    // Returns false if the rewound board couldn't be loaded into the workers.
+    auto rewind = [&](size_t steps) {
+        if (historyEnabled && history->rewind(std::min(steps, history->available()), packedBoard.get())) {
+            game.unpackCells(packedBoard.get());
+#ifdef __linux__
+            if (striped && !striped->load(packedBoard.get())) {
+                std::cerr << "Couldn't load the board into the workers." << std::endl;
+                return false;
+            }
+#endif
+        }
+        return true;
+    };
+
+    FrameScheduler scheduler{options.generationsPerSecond, options.framesPerSecond};
 
     SDL_Event event{};
     bool running{true};
+    bool paused{false};
+    int exitCode{0};
     while (running) {
-        if (SDL_PollEvent(&event) != 0 && event.type == SDL_QUIT) {
+        // Handle every pending event, so that input doesn't lag behind when the loop is busy.
+        while (SDL_PollEvent(&event) != 0) {
+            if (event.type == SDL_QUIT) {
+                running = false;
+            } else if (event.type == SDL_KEYDOWN) {
+                switch (event.key.keysym.sym) {
+                    case SDLK_SPACE: paused = !paused; break;
+                    case SDLK_RIGHT:
+                        if (paused && running && !advance()) {
+                            running = false;
+                            exitCode = -1;
+                        }
+                        break;
+                    case SDLK_LEFT:
+                        paused = true;
+                        if (!rewind((event.key.keysym.mod & KMOD_SHIFT) ? REWIND_FAST_STEPS : 1)) {
+                            running = false;
+                            exitCode = -1;
+                        }
+                        break;
+                    case SDLK_h:
+                        showHeatmap = !showHeatmap;
+                        if (showHeatmap) {
+                            game.setActivityTracking(true);
+                        }
+                        break;
+                    default: break;
+                }
+            }
+        }
+        if (!running) {
+            break;
+        }
+
+        scheduler.setPaused(paused);
+        if (!scheduler.runGenerations(advance)) {
             running = false;
+            exitCode = -1;
         }
 
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-        SDL_RenderClear(renderer);
+        if (scheduler.frameDue()) {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+            SDL_RenderClear(renderer);
 
-        game.nextIteration();
-        game.draw(renderer);
+            if (showHeatmap) {
+                game.drawActivity(renderer, heatmapTexture);
+            } else {
+                game.draw(renderer);
+            }
 
-        SDL_RenderPresent(renderer);
-        SDL_Delay(DELAY_REFRESH_MILLIS);
+            SDL_RenderPresent(renderer);
+        }
+
+        scheduler.waitForNextDeadline();
     }
 
+    recorder.close();
+
+    SDL_DestroyTexture(heatmapTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
-    return 0;
+    return exitCode;
 }
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include "packed_rows.hpp"
+
+const char MAPPED_MAGIC[8] = {'G', 'O', 'L', 'M', 'A', 'P', '0', '1'};
+
+// The rows start at this offset of the file, so that they're page aligned.
+const size_t MAPPED_HEADER_BYTES = 4096;
+
+// Amount of rows, in bytes, prefetched ahead of the sweep and released behind it.
+const size_t MAPPED_BAND_BYTES = (size_t)64 << 20;
+
+// Board stored as packed rows in a memory-mapped file, for boards that don't fit in memory.
+//
+// The file starts with a header holding the board dimensions and its generation, followed by the
+// rows in the layout of `packed_rows.hpp`. New files are sparse, so that a mostly dead board takes
+// little disk space.
+//
+// Each generation is a single sequential sweep over the rows that keeps only copies of the three
+// rows around the current one: the new row is computed from those copies and written back in place.
+// Rows that don't change aren't written back, so still regions never get dirtied. The mapping is
+// advised as sequential, the band ahead of the sweep is prefetched, and the band behind it is
+// released, so the resident set stays bounded and the work runs at disk bandwidth.
+class MappedBoard {
+  private:
+    struct Header {
+        char magic[8];
+        uint64_t cols;
+        uint64_t rows;
+        uint64_t generation;
+    };
+
+    int fd;
+    uint8_t* mapping;
+    size_t mappingBytes;
+    Header* header;
+
+    uint64_t cols;
+    uint64_t rows;
+    size_t rowWords;
+    size_t bandRows;
+
+    // Bytes taken by the rows of a board of the given size, or 0 if the size is empty or the rows
+    // can't fit in a file that we can map.
+    static size_t boardBytes(uint64_t boardCols, uint64_t boardRows) {
+        if (boardCols == 0 || boardRows == 0 || boardCols > std::numeric_limits<uint64_t>::max() - 63) {
+            return 0;
+        }
+        uint64_t rowBytes = (boardCols + 63) / 64 * sizeof(uint64_t);
+        uint64_t maxBytes =
+            std::min<uint64_t>(std::numeric_limits<size_t>::max(), (uint64_t)std::numeric_limits<off_t>::max()) -
+            MAPPED_HEADER_BYTES;
+        if (boardRows > maxBytes / rowBytes) {
+            return 0;
+        }
+        return (size_t)(boardRows * rowBytes);
+    }
+
+    // Returns whether a new board of the given size can be created, telling why otherwise.
+    static bool checkNewSize(const char* path, uint64_t newCols, uint64_t newRows) {
+        if (newCols == 0 || newRows == 0) {
+            std::cerr << "The size of the new board " << path << " must be given." << std::endl;
+            return false;
+        }
+        if (boardBytes(newCols, newRows) == 0) {
+            std::cerr << "The board size " << newCols << "x" << newRows << " is too large." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t* row(uint64_t rowIdx) const {
+        return reinterpret_cast<uint64_t*>(mapping + MAPPED_HEADER_BYTES) + rowIdx * rowWords;
+    }
+
+    // Page aligned range of the file covering the rows [firstRow, firstRow + rowCount).
+    void bandRange(uint64_t firstRow, uint64_t rowCount, uint8_t*& start, size_t& bytes) const {
+        size_t pageBytes = (size_t)sysconf(_SC_PAGESIZE);
+        uint8_t* first = reinterpret_cast<uint8_t*>(row(firstRow));
+        uint8_t* last = reinterpret_cast<uint8_t*>(row(firstRow + rowCount));
+        start = mapping + ((size_t)(first - mapping) / pageBytes) * pageBytes;
+        bytes = (size_t)(last - start);
+    }
+
+    void prefetchBand(uint64_t firstRow) const {
+        if (firstRow >= rows) {
+            return;
+        }
+        uint8_t* start;
+        size_t bytes;
+        bandRange(firstRow, std::min<uint64_t>(bandRows, rows - firstRow), start, bytes);
+        madvise(start, bytes, MADV_WILLNEED);
+    }
+
+    // Drops a band that the sweep is done with from our resident set and from the page cache. Its
+    // dirty pages are written back by the kernel.
+    void releaseBand(uint64_t firstRow) const {
+        uint8_t* start;
+        size_t bytes;
+        bandRange(firstRow, std::min<uint64_t>(bandRows, rows - firstRow), start, bytes);
+        msync(start, bytes, MS_ASYNC);
+        madvise(start, bytes, MADV_DONTNEED);
+        posix_fadvise(fd, (off_t)(start - mapping), (off_t)bytes, POSIX_FADV_DONTNEED);
+    }
+
+    void stepOnce(uint64_t* buffers) {
+        uint64_t lastWordMask = packedLastWordMask((unsigned int)(cols % 64));
+        size_t rowBytes = rowWords * sizeof(uint64_t);
+
+        uint64_t* above = buffers;
+        uint64_t* current = buffers + rowWords;
+        uint64_t* below = buffers + 2 * rowWords;
+        uint64_t* next = buffers + 3 * rowWords;
+
+        std::memset(above, 0, rowBytes);
+        std::memcpy(current, row(0), rowBytes);
+        prefetchBand(0);
+
+        for (uint64_t rowIdx = 0; rowIdx < rows; rowIdx++) {
+            if (rowIdx % bandRows == 0) {
+                prefetchBand(rowIdx + bandRows);
+                if (rowIdx >= bandRows) {
+                    releaseBand(rowIdx - bandRows);
+                }
+            }
+
+            if (rowIdx + 1 < rows) {
+                std::memcpy(below, row(rowIdx + 1), rowBytes);
+            } else {
+                std::memset(below, 0, rowBytes);
+            }
+
+            stepPackedRow(above, current, below, next, rowWords, lastWordMask);
+            if (std::memcmp(next, current, rowBytes) != 0) {
+                std::memcpy(row(rowIdx), next, rowBytes);
+            }
+
+            uint64_t* oldAbove = above;
+            above = current;
+            current = below;
+            below = oldAbove;
+        }
+        releaseBand(((rows - 1) / bandRows) * bandRows);
+    }
+
+  public:
+    MappedBoard() : fd{-1}, mapping{nullptr}, mappingBytes{0}, header{nullptr}, cols{0}, rows{0}, rowWords{0}, bandRows{1} {}
+
+    ~MappedBoard() {
+        if (mapping != nullptr) {
+            munmap(mapping, mappingBytes);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    MappedBoard(const MappedBoard&) = delete;
+    MappedBoard& operator=(const MappedBoard&) = delete;
+
+    // Opens the board stored at `path`, or creates an empty board of the given size if the file
+    // doesn't exist yet. Existing boards must match the given size unless it's zero.
+    bool open(const char* path, uint64_t newCols, uint64_t newRows) {
+        // The file is only created once we know it can hold the new board, so that failures don't
+        // leave empty files behind.
+        bool created = false;
+        fd = ::open(path, O_RDWR);
+        if (fd < 0 && errno == ENOENT) {
+            if (!checkNewSize(path, newCols, newRows)) {
+                return false;
+            }
+            fd = ::open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+            created = fd >= 0;
+        }
+        struct stat fileStat;
+        if (fd < 0 || fstat(fd, &fileStat) != 0) {
+            std::cerr << "Couldn't open the board file " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        Header fileHeader{};
+        bool isNew = fileStat.st_size == 0;
+        if (isNew) {
+            if (!checkNewSize(path, newCols, newRows)) {
+                return false;
+            }
+            std::memcpy(fileHeader.magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC));
+            fileHeader.cols = newCols;
+            fileHeader.rows = newRows;
+        } else if (
+            pread(fd, &fileHeader, sizeof(fileHeader), 0) != (ssize_t)sizeof(fileHeader) ||
+            std::memcmp(fileHeader.magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC)) != 0) {
+            std::cerr << "The file " << path << " doesn't hold a board." << std::endl;
+            return false;
+        } else if ((newCols != 0 && newCols != fileHeader.cols) || (newRows != 0 && newRows != fileHeader.rows)) {
+            std::cerr << "The board " << path << " is " << fileHeader.cols << "x" << fileHeader.rows
+                      << ", not " << newCols << "x" << newRows << "." << std::endl;
+            return false;
+        }
+
+        // A corrupt header could hold an empty board, or one whose size overflows.
+        size_t rowsBytes = boardBytes(fileHeader.cols, fileHeader.rows);
+        if (rowsBytes == 0) {
+            std::cerr << "The file " << path << " doesn't hold a board." << std::endl;
+            return false;
+        }
+
+        cols = fileHeader.cols;
+        rows = fileHeader.rows;
+        rowWords = (size_t)((cols + 63) / 64);
+        bandRows = std::max<size_t>(MAPPED_BAND_BYTES / (rowWords * sizeof(uint64_t)), 1);
+        mappingBytes = MAPPED_HEADER_BYTES + rowsBytes;
+
+        // Growing the file with ftruncate leaves it sparse.
+        if (isNew && (ftruncate(fd, (off_t)mappingBytes) != 0 || pwrite(fd, &fileHeader, sizeof(fileHeader), 0) != (ssize_t)sizeof(fileHeader))) {
+            std::cerr << "Couldn't create the board file " << path << ": " << std::strerror(errno) << std::endl;
+            if (created) {
+                unlink(path);
+            }
+            return false;
+        }
+        if ((uint64_t)fileStat.st_size < mappingBytes && !isNew) {
+            std::cerr << "The board file " << path << " is truncated." << std::endl;
+            return false;
+        }
+
+        void* memory = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED) {
+            std::cerr << "Couldn't map the board file " << path << ": " << std::strerror(errno) << std::endl;
+            if (created) {
+                unlink(path);
+            }
+            return false;
+        }
+        mapping = static_cast<uint8_t*>(memory);
+        header = reinterpret_cast<Header*>(mapping);
+        madvise(mapping, mappingBytes, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    uint64_t getCols() const {
+        return cols;
+    }
+
+    uint64_t getRows() const {
+        return rows;
+    }
+
+    uint64_t generation() const {
+        return header->generation;
+    }
+
+    // Replaces the board with the packed one, only sensible for boards that fit in memory.
+    void load(const uint64_t* words) {
+        std::memcpy(row(0), words, rows * rowWords * sizeof(uint64_t));
+    }
+
+    // Copies the board into the packed one, only sensible for boards that fit in memory.
+    void store(uint64_t* words) const {
+        std::memcpy(words, row(0), rows * rowWords * sizeof(uint64_t));
+    }
+
+    void step(unsigned int generations) {
+        std::unique_ptr<uint64_t[]> buffers{new uint64_t[4 * rowWords]};
+        for (unsigned int generation = 0; generation < generations; generation++) {
+            stepOnce(buffers.get());
+            header->generation++;
+        }
+    }
+};
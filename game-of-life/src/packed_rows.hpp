@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Helpers for boards packed one bit per cell, in the same layout as `GameState::packCells`: each row
+// starts at a new 64-bit word and cell `x` of a row lives in the bit `x % 64` of the word `x / 64`.
+// Bits past the last column must always be zero.
+
+inline size_t packedRowWords(unsigned int cols) {
+    return (cols + 63) / 64;
+}
+
+// Mask of the bits of the last word of a row that correspond to actual cells.
+inline uint64_t packedLastWordMask(unsigned int cols) {
+    return (cols % 64 == 0) ? ~(uint64_t)0 : ((uint64_t)1 << (cols % 64)) - 1;
+}
+
+// Computes the next generation of `row` into `out`, where `above` and `below` are its neighbouring
+// rows (pass a zeroed row for the board borders, which count as dead cells).
+//
+// The eight neighbours of all 64 cells of a word are summed at once with bit-sliced adders keeping
+// the count modulo 8: a count of 8 wraps to 0 but both mean death, so that's harmless.
+inline void stepPackedRow(
+    const uint64_t* above,
+    const uint64_t* row,
+    const uint64_t* below,
+    uint64_t* out,
+    size_t rowWords,
+    uint64_t lastWordMask) {
+    for (size_t wordIdx = 0; wordIdx < rowWords; wordIdx++) {
+        bool hasWest = wordIdx > 0;
+        bool hasEast = wordIdx + 1 < rowWords;
+
+        uint64_t neighbours[8];
+        const uint64_t* lines[3] = {above, row, below};
+        unsigned int count = 0;
+        for (unsigned int lineIdx = 0; lineIdx < 3; lineIdx++) {
+            const uint64_t* line = lines[lineIdx];
+            uint64_t centre = line[wordIdx];
+            // Cell x - 1 shifted into bit x, and cell x + 1 shifted into bit x.
+            neighbours[count++] = (centre << 1) | (hasWest ? line[wordIdx - 1] >> 63 : 0);
+            neighbours[count++] = (centre >> 1) | (hasEast ? line[wordIdx + 1] << 63 : 0);
+            if (lineIdx != 1) {
+                neighbours[count++] = centre;
+            }
+        }
+
+        uint64_t ones = 0;
+        uint64_t twos = 0;
+        uint64_t fours = 0;
+        for (uint64_t neighbour : neighbours) {
+            uint64_t carryOnes = ones & neighbour;
+            ones ^= neighbour;
+            uint64_t carryTwos = twos & carryOnes;
+            twos ^= carryOnes;
+            fours ^= carryTwos;
+        }
+
+        // Alive with exactly 3 neighbours, or with 2 neighbours if the cell was already alive.
+        uint64_t next = ~fours & twos & (ones | row[wordIdx]);
+        out[wordIdx] = hasEast ? next : next & lastWordMask;
+    }
+}
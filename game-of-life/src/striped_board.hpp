@@ -0,0 +1,449 @@
+#pragma once
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "packed_rows.hpp"
+
+const unsigned int STRIPED_MAX_WORKERS = 64;
+
+// How long a process sleeps on a barrier before checking whether another process died.
+const long STRIPED_WAIT_TIMEOUT_NANOS = 100 * 1000 * 1000;
+const unsigned int STRIPED_SPIN_COUNT = 4096;
+
+// Memory policy of mbind(2), defined here so that we don't depend on libnuma's headers.
+const int STRIPED_MPOL_BIND = 2;
+
+// Steps a packed board split into horizontal stripes, each one owned by a separate worker process.
+//
+// Every stripe lives in its own shared memory segment, which is stepped only by its worker and bound
+// to the memory of the worker's NUMA node, and is double-buffered with a halo row above and below.
+// Each generation the workers publish their first and last rows into a mailbox in the control
+// segment, meet at a futex-based barrier, copy their neighbours' rows into their halos, and step
+// their stripe independently. Mailboxes alternate with the parity of the generation, so a single
+// barrier per generation is enough.
+//
+// The coordinating process (the one that owns this object) also maps every stripe once the workers
+// are spawned, to copy the board in and out of them when loading or storing it. The whole board
+// thus still has to fit in the address space of the coordinator: the stripes spread the stepping
+// over processes and NUMA nodes, not the memory of a board larger than one process can map.
+//
+// The design maps onto MPI: stripes are the local memory of each rank, the mailbox exchange is a
+// pair of MPI_Sendrecv, the barriers are MPI_Barrier and `load`/`store` are a scatter and a gather.
+//
+// Workers are killed along with the coordinator, and give up on their own if it goes away anyway.
+class StripedBoard {
+  private:
+    struct FutexBarrier {
+        std::atomic<uint32_t> arrived;
+        std::atomic<uint32_t> phase;
+        uint32_t parties;
+    };
+
+    static_assert(
+        sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+        "Futexes operate on plain 32-bit words");
+
+    enum class Command : uint32_t {
+        Step,
+        Exit,
+    };
+
+    struct alignas(64) Control {
+        // Synchronises the coordinator with all workers, before and after each command.
+        alignas(64) FutexBarrier commandBarrier;
+        // Synchronises the workers among themselves, once per generation.
+        alignas(64) FutexBarrier haloBarrier;
+        alignas(64) Command command;
+        uint32_t steps;
+        uint64_t generation;
+        std::atomic<uint32_t> aborted;
+    };
+
+    unsigned int cols;
+    unsigned int rows;
+    unsigned int workerCount;
+    size_t rowWords;
+
+    int controlFd;
+    size_t controlBytes;
+    Control* control;
+    uint64_t* mailboxes;
+
+    std::vector<int> stripeFds;
+    // Mappings of the stripes in the coordinating process.
+    std::vector<uint64_t*> stripes;
+    std::vector<pid_t> workers;
+    pid_t coordinator;
+    bool isWorker;
+
+    unsigned int firstRowOf(unsigned int workerIdx) const {
+        return (unsigned int)((uint64_t)rows * workerIdx / workerCount);
+    }
+
+    unsigned int rowCountOf(unsigned int workerIdx) const {
+        return firstRowOf(workerIdx + 1) - firstRowOf(workerIdx);
+    }
+
+    size_t stripeBytesOf(unsigned int workerIdx) const {
+        return 2 * (rowCountOf(workerIdx) + 2) * rowWords * sizeof(uint64_t);
+    }
+
+    // Row `rowIdx` of the given buffer of a stripe, where rows -1 and `rowCount` are the halos.
+    uint64_t* stripeRow(uint64_t* stripe, unsigned int rowCount, uint64_t buffer, int rowIdx) const {
+        return stripe + ((buffer & 1) * (rowCount + 2) + (size_t)(rowIdx + 1)) * rowWords;
+    }
+
+    // Mailbox slot where a worker publishes its top (side 0) or bottom (side 1) row.
+    uint64_t* mailbox(uint64_t generation, unsigned int workerIdx, unsigned int side) const {
+        return mailboxes + (((generation & 1) * workerCount + workerIdx) * 2 + side) * rowWords;
+    }
+
+    static long futex(std::atomic<uint32_t>* word, int op, uint32_t value, const timespec* timeout) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, value, timeout, nullptr, 0);
+    }
+
+    bool anyWorkerDied() {
+        for (pid_t& worker : workers) {
+            if (worker > 0 && waitpid(worker, nullptr, WNOHANG) == worker) {
+                worker = -1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool waitBarrier(FutexBarrier& barrier) {
+        uint32_t phase = barrier.phase.load(std::memory_order_acquire);
+        if (barrier.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == barrier.parties) {
+            barrier.arrived.store(0, std::memory_order_relaxed);
+            barrier.phase.fetch_add(1, std::memory_order_release);
+            futex(&barrier.phase, FUTEX_WAKE, INT_MAX, nullptr);
+            return true;
+        }
+
+        for (unsigned int spin = 0; spin < STRIPED_SPIN_COUNT; spin++) {
+            if (barrier.phase.load(std::memory_order_acquire) != phase) {
+                return true;
+            }
+        }
+
+        timespec timeout{0, STRIPED_WAIT_TIMEOUT_NANOS};
+        while (barrier.phase.load(std::memory_order_acquire) == phase) {
+            if (control->aborted.load(std::memory_order_relaxed) != 0) {
+                return false;
+            }
+            // Workers give up once the coordinator is gone, the coordinator once any worker is.
+            bool peerDied = isWorker ? getppid() != coordinator : anyWorkerDied();
+            if (peerDied) {
+                control->aborted.store(1, std::memory_order_relaxed);
+                futex(&control->commandBarrier.phase, FUTEX_WAKE, INT_MAX, nullptr);
+                futex(&control->haloBarrier.phase, FUTEX_WAKE, INT_MAX, nullptr);
+                return false;
+            }
+            futex(&barrier.phase, FUTEX_WAIT, phase, &timeout);
+        }
+        return true;
+    }
+
+    static bool createSegment(const std::string& name, size_t bytes, int& fd) {
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            return false;
+        }
+        // Nobody else needs to find the segment by name, the workers inherit the descriptor.
+        shm_unlink(name.c_str());
+        return ftruncate(fd, (off_t)bytes) == 0;
+    }
+
+    static void* mapSegment(int fd, size_t bytes) {
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return (memory == MAP_FAILED) ? nullptr : memory;
+    }
+
+    static unsigned int numaNodeCount() {
+        // The file lists the online nodes as ranges such as "0-3".
+        unsigned int lastNode = 0;
+        if (std::FILE* file = std::fopen("/sys/devices/system/node/online", "r")) {
+            unsigned int first = 0;
+            if (std::fscanf(file, "%u-%u", &first, &lastNode) < 2) {
+                lastNode = first;
+            }
+            std::fclose(file);
+        }
+        return lastNode + 1;
+    }
+
+    // Best effort: runs the calling process on the CPUs of the node and binds the memory range to it.
+    static void pinToNumaNode(unsigned int node, void* memory, size_t bytes) {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        bool anyCpu = false;
+        if (std::FILE* file = std::fopen(path, "r")) {
+            // The file lists CPUs as comma-separated ranges such as "0-3,8-11".
+            unsigned int first = 0;
+            while (std::fscanf(file, "%u", &first) == 1) {
+                unsigned int last = first;
+                int separator = std::fgetc(file);
+                if (separator == '-') {
+                    if (std::fscanf(file, "%u", &last) != 1) {
+                        break;
+                    }
+                    separator = std::fgetc(file);
+                }
+                for (unsigned int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+                    CPU_SET(cpu, &cpus);
+                    anyCpu = true;
+                }
+                if (separator != ',') {
+                    break;
+                }
+            }
+            std::fclose(file);
+        }
+        if (anyCpu) {
+            sched_setaffinity(0, sizeof(cpus), &cpus);
+        }
+
+        unsigned long nodeMask = 1ul << node;
+        syscall(SYS_mbind, memory, bytes, STRIPED_MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, 0);
+    }
+
+    void runWorker(unsigned int workerIdx) {
+        isWorker = true;
+
+        size_t stripeBytes = stripeBytesOf(workerIdx);
+        unsigned int rowCount = rowCountOf(workerIdx);
+        uint64_t* stripe = static_cast<uint64_t*>(mapSegment(stripeFds[workerIdx], stripeBytes));
+        if (stripe == nullptr) {
+            control->aborted.store(1, std::memory_order_relaxed);
+            _exit(1);
+        }
+
+        // Bind before the first touch so that every page is allocated on our node.
+        pinToNumaNode(workerIdx % numaNodeCount(), stripe, stripeBytes);
+        std::memset(stripe, 0, stripeBytes);
+
+        uint64_t lastWordMask = packedLastWordMask(cols);
+        bool hasAbove = workerIdx > 0;
+        bool hasBelow = workerIdx + 1 < workerCount;
+
+        // Tell the coordinator we're ready.
+        bool ok = waitBarrier(control->commandBarrier);
+        while (ok) {
+            ok = waitBarrier(control->commandBarrier);
+            if (!ok || control->command == Command::Exit) {
+                break;
+            }
+
+            uint64_t generation = control->generation;
+            for (uint32_t step = 0; ok && step < control->steps; step++, generation++) {
+                std::memcpy(mailbox(generation, workerIdx, 0), stripeRow(stripe, rowCount, generation, 0), rowWords * sizeof(uint64_t));
+                std::memcpy(mailbox(generation, workerIdx, 1), stripeRow(stripe, rowCount, generation, (int)rowCount - 1), rowWords * sizeof(uint64_t));
+                if (!waitBarrier(control->haloBarrier)) {
+                    ok = false;
+                    break;
+                }
+
+                // The halos of the outermost stripes are never written, so they stay as dead cells.
+                if (hasAbove) {
+                    std::memcpy(stripeRow(stripe, rowCount, generation, -1), mailbox(generation, workerIdx - 1, 1), rowWords * sizeof(uint64_t));
+                }
+                if (hasBelow) {
+                    std::memcpy(stripeRow(stripe, rowCount, generation, (int)rowCount), mailbox(generation, workerIdx + 1, 0), rowWords * sizeof(uint64_t));
+                }
+
+                for (int rowIdx = 0; rowIdx < (int)rowCount; rowIdx++) {
+                    stepPackedRow(
+                        stripeRow(stripe, rowCount, generation, rowIdx - 1),
+                        stripeRow(stripe, rowCount, generation, rowIdx),
+                        stripeRow(stripe, rowCount, generation, rowIdx + 1),
+                        stripeRow(stripe, rowCount, generation + 1, rowIdx),
+                        rowWords,
+                        lastWordMask);
+                }
+            }
+
+            ok = ok && waitBarrier(control->commandBarrier);
+        }
+
+        _exit(ok ? 0 : 1);
+    }
+
+    // Copies the current buffer of every stripe from (`toStripes`) or into the packed board.
+    bool transfer(uint64_t* words, bool toStripes) const {
+        if (stripes.size() != workerCount) {
+            return false;
+        }
+
+        for (unsigned int workerIdx = 0; workerIdx < workerCount; workerIdx++) {
+            unsigned int rowCount = rowCountOf(workerIdx);
+            uint64_t* current = stripeRow(stripes[workerIdx], rowCount, control->generation, 0);
+            uint64_t* board = words + (size_t)firstRowOf(workerIdx) * rowWords;
+            size_t bytes = (size_t)rowCount * rowWords * sizeof(uint64_t);
+            if (toStripes) {
+                std::memcpy(current, board, bytes);
+            } else {
+                std::memcpy(board, current, bytes);
+            }
+        }
+        return true;
+    }
+
+  public:
+    StripedBoard(unsigned int cols, unsigned int rows, unsigned int workerCount)
+        : cols{cols},
+          rows{rows},
+          workerCount{workerCount},
+          rowWords{packedRowWords(cols)},
+          controlFd{-1},
+          controlBytes{0},
+          control{nullptr},
+          mailboxes{nullptr},
+          coordinator{-1},
+          isWorker{false} {}
+
+    ~StripedBoard() {
+        if (control != nullptr && !workers.empty()) {
+            control->command = Command::Exit;
+            waitBarrier(control->commandBarrier);
+            for (pid_t worker : workers) {
+                if (worker > 0) {
+                    waitpid(worker, nullptr, 0);
+                }
+            }
+        }
+        for (size_t workerIdx = 0; workerIdx < stripes.size(); workerIdx++) {
+            munmap(stripes[workerIdx], stripeBytesOf((unsigned int)workerIdx));
+        }
+        if (control != nullptr) {
+            munmap(control, controlBytes);
+        }
+        if (controlFd >= 0) {
+            close(controlFd);
+        }
+        for (int fd : stripeFds) {
+            close(fd);
+        }
+    }
+
+    StripedBoard(const StripedBoard&) = delete;
+    StripedBoard& operator=(const StripedBoard&) = delete;
+
+    // Creates the shared memory segments and spawns the workers. Must be called before the calling
+    // process starts any thread, since the workers are forked from it.
+    bool start() {
+        if (workerCount == 0 || workerCount > STRIPED_MAX_WORKERS || workerCount > rows) {
+            std::cerr << "The number of workers must be between 1 and " << STRIPED_MAX_WORKERS
+                      << " and can't exceed the number of rows." << std::endl;
+            return false;
+        }
+
+        coordinator = getpid();
+        std::string prefix = "/gol-" + std::to_string(coordinator);
+        size_t mailboxBytes = 2 * (size_t)workerCount * 2 * rowWords * sizeof(uint64_t);
+        controlBytes = sizeof(Control) + mailboxBytes;
+        if (!createSegment(prefix + "-control", controlBytes, controlFd)) {
+            std::cerr << "Couldn't create the control segment: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        control = static_cast<Control*>(mapSegment(controlFd, controlBytes));
+        if (control == nullptr) {
+            std::cerr << "Couldn't map the control segment: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        mailboxes = reinterpret_cast<uint64_t*>(control + 1);
+
+        // The segment starts zeroed, only the party counts need to be set.
+        control->commandBarrier.parties = workerCount + 1;
+        control->haloBarrier.parties = workerCount;
+
+        for (unsigned int workerIdx = 0; workerIdx < workerCount; workerIdx++) {
+            int fd = -1;
+            if (!createSegment(prefix + "-stripe-" + std::to_string(workerIdx), stripeBytesOf(workerIdx), fd)) {
+                std::cerr << "Couldn't create the segment of stripe " << workerIdx << ": "
+                          << std::strerror(errno) << std::endl;
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return false;
+            }
+            stripeFds.push_back(fd);
+        }
+
+        for (unsigned int workerIdx = 0; workerIdx < workerCount; workerIdx++) {
+            pid_t worker = fork();
+            if (worker == 0) {
+                // The coordinator may have died before the signal was requested, in which case we
+                // were already reparented.
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+                if (getppid() != coordinator) {
+                    _exit(1);
+                }
+                runWorker(workerIdx);
+            } else if (worker < 0) {
+                std::cerr << "Couldn't spawn worker " << workerIdx << ": " << std::strerror(errno) << std::endl;
+                control->aborted.store(1, std::memory_order_relaxed);
+                return false;
+            }
+            workers.push_back(worker);
+        }
+
+        // Mapped after forking, so that the workers only ever map their own stripe.
+        for (unsigned int workerIdx = 0; workerIdx < workerCount; workerIdx++) {
+            uint64_t* stripe = static_cast<uint64_t*>(mapSegment(stripeFds[workerIdx], stripeBytesOf(workerIdx)));
+            if (stripe == nullptr) {
+                std::cerr << "Couldn't map the segment of stripe " << workerIdx << ": " << std::strerror(errno)
+                          << std::endl;
+                control->aborted.store(1, std::memory_order_relaxed);
+                return false;
+            }
+            stripes.push_back(stripe);
+        }
+
+        // Wait for every worker to have its stripe ready.
+        return waitBarrier(control->commandBarrier);
+    }
+
+    // Replaces the board with the packed one.
+    bool load(const uint64_t* words) {
+        return transfer(const_cast<uint64_t*>(words), true);
+    }
+
+    // Copies the board into the packed one.
+    bool store(uint64_t* words) const {
+        return transfer(words, false);
+    }
+
+    // Advances the board by the given number of generations, returns false if a worker died.
+    bool step(unsigned int generations) {
+        control->command = Command::Step;
+        control->steps = generations;
+        if (!waitBarrier(control->commandBarrier) || !waitBarrier(control->commandBarrier)) {
+            std::cerr << "A worker of the striped board stopped unexpectedly." << std::endl;
+            return false;
+        }
+        control->generation += generations;
+        return true;
+    }
+};
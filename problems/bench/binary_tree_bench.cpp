@@ -0,0 +1,416 @@
+// ------------------------------------------------------------------------------------------------
+// Title: BinaryTree benchmarks.
+// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+// ------------------------------------------------------------------------------------------------
+// Description:
+//
+// Measures how BinaryTree scales against std::set and a sorted std::vector searched with
+// std::lower_bound, along with the other search structures built on it: bulk building, batched
+// lookups, the Eytzinger index and the S+ tree.
+//
+// Every container is run on streams of uniform, sorted and Zipfian keys, for sizes growing tenfold
+// from 1K keys up to the given maximum. Each operation reports its throughput and the percentiles
+// of the latencies of a sample of single operations, each container its memory per key and, for
+// the trees, their depth.
+//
+// Usage: binary_tree_bench [max key count = 1000000] [lookup count = 1000000]
+//
+// @NOTE: 100M keys take about 5GB for std::set alone.
+// ------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <binary_tree.hpp>
+#include <chrono>
+#include <cmath>
+#include <common.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <eytzinger_index.hpp>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <s_tree.hpp>
+#include <set>
+#include <span>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Every LATENCY_SAMPLE_STRIDE-th operation is timed on its own for the latency percentiles.
+static constexpr size_t LATENCY_SAMPLE_STRIDE = 64;
+
+static constexpr size_t MIN_KEY_COUNT = 1000;
+
+static constexpr size_t MIN_MAX_CALL_COUNT = 1'000'000;
+
+// Lookups given to find_batch at once.
+static constexpr size_t LOOKUP_BATCH_SIZE = 4096;
+
+static constexpr double ZIPF_EXPONENT = 0.99;
+
+// Results are accumulated here and printed, so that the compiler can't drop the measured work.
+static size_t result_checksum = 0;
+
+// Bytes held by the containers using CountingAllocator, whatever the type they allocate.
+static size_t counted_allocated_bytes = 0;
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    constexpr CountingAllocator(CountingAllocator<U> const&) noexcept {}
+
+    T* allocate(size_t count) {
+        counted_allocated_bytes += count * sizeof(T);
+        return std::allocator<T>{}.allocate(count);
+    }
+
+    void deallocate(T* ptr, size_t count) noexcept {
+        counted_allocated_bytes -= count * sizeof(T);
+        std::allocator<T>{}.deallocate(ptr, count);
+    }
+
+    template <typename U>
+    bool operator==(CountingAllocator<U> const&) const noexcept {
+        return true;
+    }
+};
+
+// Draws ranks in [0, item_count) where rank r has a probability proportional to 1 / (r + 1)^s, as
+// described in "Quickly Generating Billion-Record Synthetic Databases" (Gray et al.).
+struct ZipfDistribution {
+    size_t item_count;
+    double alpha;
+    double zeta_n;
+    double eta;
+
+    explicit ZipfDistribution(size_t item_count) : item_count{item_count} {
+        double zeta_2 = 1.0 + std::pow(0.5, ZIPF_EXPONENT);
+
+        this->zeta_n = 0.0;
+        for (size_t rank = 1; rank <= item_count; ++rank) {
+            this->zeta_n += 1.0 / std::pow(static_cast<double>(rank), ZIPF_EXPONENT);
+        }
+        this->alpha = 1.0 / (1.0 - ZIPF_EXPONENT);
+        this->eta   = (1.0 - std::pow(2.0 / static_cast<double>(item_count), 1.0 - ZIPF_EXPONENT)) / (1.0 - zeta_2 / this->zeta_n);
+    }
+
+    template <typename Rng>
+    size_t operator()(Rng& rng) {
+        double uniform = std::uniform_real_distribution<double>{0.0, 1.0}(rng);
+        double scaled  = uniform * this->zeta_n;
+        if (scaled < 1.0) {
+            return 0;
+        }
+        if (scaled < 1.0 + std::pow(0.5, ZIPF_EXPONENT)) {
+            return 1;
+        }
+        double rank = static_cast<double>(this->item_count) * std::pow(this->eta * uniform - this->eta + 1.0, this->alpha);
+        return min_value(static_cast<size_t>(rank), this->item_count - 1);
+    }
+};
+
+// Spreads consecutive ranks over the whole key range, so that the popular keys of a Zipfian stream
+// aren't also the smallest ones.
+static int32_t scramble_rank(size_t rank) {
+    uint64_t hash = static_cast<uint64_t>(rank) * 0x9E3779B97F4A7C15ull;
+    return static_cast<int32_t>((hash >> 33) & 0x7FFFFFFF);
+}
+
+enum struct KeyStream {
+    UNIFORM,
+    SORTED,
+    ZIPF,
+};
+
+static char const* key_stream_name(KeyStream stream) {
+    switch (stream) {
+        case KeyStream::UNIFORM: return "uniform";
+        case KeyStream::SORTED:  return "sorted";
+        case KeyStream::ZIPF:    return "zipf";
+    }
+    return "";
+}
+
+struct Workload {
+    std::vector<int32_t> insert_keys;
+    std::vector<int32_t> lookup_keys;
+};
+
+// Lookups hit inserted keys. Zipfian streams repeat their popular keys both among the inserted keys
+// and among the looked up ones.
+static Workload make_workload(KeyStream stream, size_t key_count, size_t lookup_count) {
+    std::mt19937_64 rng{key_count};
+    Workload        workload;
+    workload.insert_keys.resize(key_count);
+    workload.lookup_keys.resize(lookup_count);
+
+    switch (stream) {
+        case KeyStream::UNIFORM: {
+            for (int32_t& key : workload.insert_keys) {
+                key = static_cast<int32_t>(rng() & 0x7FFFFFFF);
+            }
+            for (int32_t& key : workload.lookup_keys) {
+                key = workload.insert_keys[rng() % key_count];
+            }
+            break;
+        }
+        case KeyStream::SORTED: {
+            for (size_t idx = 0; idx < key_count; ++idx) {
+                workload.insert_keys[idx] = static_cast<int32_t>(2 * idx);
+            }
+            for (int32_t& key : workload.lookup_keys) {
+                key = workload.insert_keys[rng() % key_count];
+            }
+            break;
+        }
+        case KeyStream::ZIPF: {
+            ZipfDistribution zipf{key_count};
+            for (int32_t& key : workload.insert_keys) {
+                key = scramble_rank(zipf(rng));
+            }
+            for (int32_t& key : workload.lookup_keys) {
+                key = scramble_rank(zipf(rng));
+            }
+            break;
+        }
+    }
+    return workload;
+}
+
+struct Measurement {
+    double ops_per_second = 0.0;
+    // Zero when the operation isn't timed one by one.
+    double p50_ns  = 0.0;
+    double p99_ns  = 0.0;
+    double p999_ns = 0.0;
+};
+
+// Runs the operation for each index in [0, op_count), timing the whole run and a sample of single runs.
+template <typename Operation>
+static Measurement measure(size_t op_count, Operation&& operation) {
+    std::vector<double> latencies_ns;
+    latencies_ns.reserve(op_count / LATENCY_SAMPLE_STRIDE + 1);
+
+    Clock::time_point start = Clock::now();
+    for (size_t op_idx = 0; op_idx < op_count; ++op_idx) {
+        if (op_idx % LATENCY_SAMPLE_STRIDE != 0) {
+            operation(op_idx);
+            continue;
+        }
+
+        Clock::time_point op_start = Clock::now();
+        operation(op_idx);
+        latencies_ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - op_start).count());
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    auto percentile = [&](double fraction) {
+        return latencies_ns[min_value(static_cast<size_t>(fraction * static_cast<double>(latencies_ns.size())), latencies_ns.size() - 1)];
+    };
+
+    return Measurement{
+        .ops_per_second = static_cast<double>(op_count) / seconds,
+        .p50_ns         = percentile(0.5),
+        .p99_ns         = percentile(0.99),
+        .p999_ns        = percentile(0.999),
+    };
+}
+
+// Times a single run of the operation, done for work_count items, without latencies.
+template <typename Operation>
+static Measurement measure_once(size_t work_count, Operation&& operation) {
+    Clock::time_point start = Clock::now();
+    operation();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return Measurement{.ops_per_second = static_cast<double>(work_count) / seconds};
+}
+
+static void print_header() {
+    std::cout << std::left << std::setw(11) << "keys" << std::setw(12) << "container" << std::setw(22) << "variant"
+              << std::setw(9) << "op" << std::right << std::setw(10) << "Mops/s" << std::setw(10) << "p50 ns"
+              << std::setw(10) << "p99 ns" << std::setw(11) << "p99.9 ns" << std::setw(11) << "bytes/key"
+              << std::setw(7) << "depth" << "\n";
+}
+
+// Bytes per key and depth are only printed when given.
+static void print_row(
+    size_t             key_count,
+    char const*        container,
+    char const*        variant,
+    char const*        op,
+    Measurement const& measurement,
+    double             bytes_per_key = 0.0,
+    size_t             depth         = 0) {
+    std::cout << std::left << std::setw(11) << key_count << std::setw(12) << container << std::setw(22) << variant
+              << std::setw(9) << op << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+              << measurement.ops_per_second / 1e6 << std::setprecision(0);
+    if (measurement.p50_ns > 0.0) {
+        std::cout << std::setw(10) << measurement.p50_ns << std::setw(10) << measurement.p99_ns << std::setw(11) << measurement.p999_ns;
+    } else {
+        std::cout << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(11) << "-";
+    }
+    std::cout << std::setprecision(1);
+    if (bytes_per_key > 0.0) {
+        std::cout << std::setw(11) << bytes_per_key;
+    } else {
+        std::cout << std::setw(11) << "-";
+    }
+    if (depth > 0) {
+        std::cout << std::setw(7) << depth;
+    } else {
+        std::cout << std::setw(7) << "-";
+    }
+    std::cout << "\n";
+}
+
+static void bench_std_set(Workload const& workload) {
+    using CountedSet = std::set<int32_t, std::less<int32_t>, CountingAllocator<int32_t>>;
+
+    size_t      key_count        = workload.insert_keys.size();
+    size_t      allocated_before = counted_allocated_bytes;
+    CountedSet  set;
+    Measurement insert = measure(key_count, [&](size_t idx) { set.insert(workload.insert_keys[idx]); });
+
+    // Doesn't count the overhead of the allocator itself.
+    double bytes_per_key = static_cast<double>(counted_allocated_bytes - allocated_before) / static_cast<double>(set.size());
+    print_row(key_count, "std::set", "", "insert", insert, bytes_per_key);
+
+    Measurement find = measure(workload.lookup_keys.size(), [&](size_t idx) {
+        result_checksum += static_cast<size_t>(set.find(workload.lookup_keys[idx]) != set.end());
+    });
+    print_row(key_count, "std::set", "", "find", find);
+
+    Measurement min_max = measure(MIN_MAX_CALL_COUNT, [&](size_t idx) {
+        result_checksum += static_cast<size_t>((idx % 2 == 0) ? *set.begin() : *set.rbegin());
+    });
+    print_row(key_count, "std::set", "", "min/max", min_max);
+}
+
+static void bench_sorted_vector(Workload const& workload, std::vector<int32_t>& sorted_keys) {
+    size_t      key_count = workload.insert_keys.size();
+    Measurement build     = measure_once(key_count, [&]() {
+        sorted_keys.assign(workload.insert_keys.begin(), workload.insert_keys.end());
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+        sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()), sorted_keys.end());
+    });
+    double bytes_per_key = static_cast<double>(sorted_keys.capacity() * sizeof(int32_t)) / static_cast<double>(sorted_keys.size());
+    print_row(key_count, "vector", "sort + unique", "build", build, bytes_per_key);
+
+    Measurement find = measure(workload.lookup_keys.size(), [&](size_t idx) {
+        int32_t key = workload.lookup_keys[idx];
+        auto    it  = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), key);
+        result_checksum += static_cast<size_t>(it != sorted_keys.end() && *it == key);
+    });
+    print_row(key_count, "vector", "lower_bound", "find", find);
+
+    Measurement min_max = measure(MIN_MAX_CALL_COUNT, [&](size_t idx) {
+        result_checksum += static_cast<size_t>((idx % 2 == 0) ? sorted_keys.front() : sorted_keys.back());
+    });
+    print_row(key_count, "vector", "", "min/max", min_max);
+}
+
+template <typename Tree>
+static double tree_bytes_per_key(Tree const& tree) {
+    size_t bytes = tree.memory.capacity() * sizeof(typename Tree::Node) + tree.free_node_indices.capacity() * sizeof(int32_t);
+    return static_cast<double>(bytes) / static_cast<double>(tree.size());
+}
+
+static void bench_binary_tree(Workload const& workload, std::vector<int32_t> const& sorted_keys) {
+    size_t key_count = workload.insert_keys.size();
+
+    {
+        BinaryTree<int32_t> tree{std::span<int32_t const>{}};
+        Measurement         insert = measure(key_count, [&](size_t idx) { tree.insert_node(workload.insert_keys[idx]); });
+        print_row(key_count, "BinaryTree", "insert_node", "insert", insert, tree_bytes_per_key(tree), tree.max_depth());
+
+        Measurement find = measure(workload.lookup_keys.size(), [&](size_t idx) {
+            result_checksum += static_cast<size_t>(tree.find_node(workload.lookup_keys[idx]) >= 0);
+        });
+        print_row(key_count, "BinaryTree", "find_node", "find", find);
+
+        Measurement min_max = measure(MIN_MAX_CALL_COUNT, [&](size_t idx) {
+            result_checksum += static_cast<size_t>((idx % 2 == 0) ? *tree.min() : *tree.max());
+        });
+        print_row(key_count, "BinaryTree", "", "min/max", min_max);
+    }
+
+    BinaryTree<int32_t> built{std::span<int32_t const>{}};
+    Measurement         build = measure_once(key_count, [&]() { built = BinaryTree<int32_t>{workload.insert_keys}; });
+    print_row(key_count, "BinaryTree", "bulk build", "build", build, tree_bytes_per_key(built), built.max_depth());
+
+    Measurement presorted_build = measure_once(key_count, [&]() { built = BinaryTree<int32_t>{sorted_keys}; });
+    print_row(key_count, "BinaryTree", "bulk build (sorted)", "build", presorted_build, tree_bytes_per_key(built), built.max_depth());
+
+    Measurement find = measure(workload.lookup_keys.size(), [&](size_t idx) {
+        result_checksum += static_cast<size_t>(built.find_node(workload.lookup_keys[idx]) >= 0);
+    });
+    print_row(key_count, "BinaryTree", "find_node (bulk)", "find", find);
+
+    std::vector<int32_t>     node_indices(LOOKUP_BATCH_SIZE);
+    std::span<int32_t const> lookup_keys = workload.lookup_keys;
+    Measurement              batch_find  = measure_once(lookup_keys.size(), [&]() {
+        for (size_t first = 0; first < lookup_keys.size(); first += LOOKUP_BATCH_SIZE) {
+            std::span<int32_t const> batch = lookup_keys.subspan(first, min_value(LOOKUP_BATCH_SIZE, lookup_keys.size() - first));
+            built.find_batch(batch, node_indices);
+            result_checksum += static_cast<size_t>(node_indices[0] >= 0);
+        }
+    });
+    print_row(key_count, "BinaryTree", "find_batch (bulk)", "find", batch_find);
+}
+
+static void bench_static_indices(Workload const& workload, std::vector<int32_t> const& sorted_keys) {
+    size_t key_count = workload.insert_keys.size();
+
+    std::optional<EytzingerIndex<int32_t>> eytzinger;
+    Measurement                            eytzinger_build = measure_once(sorted_keys.size(), [&]() { eytzinger.emplace(sorted_keys); });
+    double                                 eytzinger_bytes = static_cast<double>(eytzinger->keys.capacity() * sizeof(int32_t)) / static_cast<double>(sorted_keys.size());
+    print_row(key_count, "Eytzinger", "from sorted keys", "build", eytzinger_build, eytzinger_bytes);
+
+    Measurement eytzinger_find = measure(workload.lookup_keys.size(), [&](size_t idx) {
+        result_checksum += static_cast<size_t>(eytzinger->contains(workload.lookup_keys[idx]));
+    });
+    print_row(key_count, "Eytzinger", "contains", "find", eytzinger_find);
+
+    std::optional<STree<int32_t>> s_tree;
+    Measurement                   s_tree_build = measure_once(sorted_keys.size(), [&]() { s_tree.emplace(sorted_keys); });
+    double                        s_tree_bytes = static_cast<double>(s_tree->keys.capacity() * sizeof(int32_t)) / static_cast<double>(sorted_keys.size());
+    print_row(key_count, "STree", "from sorted keys", "build", s_tree_build, s_tree_bytes, s_tree->layer_offsets.size());
+
+    Measurement s_tree_find = measure(workload.lookup_keys.size(), [&](size_t idx) {
+        result_checksum += static_cast<size_t>(s_tree->contains(workload.lookup_keys[idx]));
+    });
+    print_row(key_count, "STree", "contains", "find", s_tree_find);
+}
+
+int main(int argc, char** argv) {
+    size_t max_key_count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    size_t lookup_count  = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+    if (max_key_count < MIN_KEY_COUNT || lookup_count == 0) {
+        std::cout << "Usage: " << argv[0] << " [max key count >= " << MIN_KEY_COUNT << "] [lookup count > 0]\n";
+        return 1;
+    }
+
+    for (KeyStream stream : {KeyStream::UNIFORM, KeyStream::SORTED, KeyStream::ZIPF}) {
+        std::cout << "\n[" << key_stream_name(stream) << " keys, " << lookup_count << " lookups]\n";
+        print_header();
+
+        for (size_t key_count = MIN_KEY_COUNT; key_count <= max_key_count; key_count *= 10) {
+            Workload workload = make_workload(stream, key_count, lookup_count);
+
+            std::vector<int32_t> sorted_keys;
+            bench_std_set(workload);
+            bench_sorted_vector(workload, sorted_keys);
+            bench_binary_tree(workload, sorted_keys);
+            bench_static_indices(workload, sorted_keys);
+        }
+    }
+
+    std::cout << "\n[INFO] Checksum: " << result_checksum << "\n";
+    return 0;
+}
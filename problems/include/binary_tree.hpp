@@ -1,66 +1,183 @@
-// @TODO:
-// - Deletion of nodes.
-// - Re-balancing algorithms.
-
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iterator>
 #include <limits>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "common.hpp"
 
-template <typename T>
+// Value type of the trees that only hold keys.
+struct NoValue {};
+
+// AVL tree: the heights of the two subtrees of any node differ by at most one, so that the depth of
+// the tree stays O(log n) whatever the order of the insertions and deletions.
+//
+// Keys are ordered by the comparator, and a tree with values maps each key to one. The values are
+// kept apart from the nodes, in an array indexed like the nodes, so that searches only ever touch
+// the nodes and as many of them fit a cache line as for a tree without values.
+//
+// With a transparent comparator, such as std::less<>, lookups take anything the comparator can
+// compare keys with, e.g. a std::string_view for std::string keys, without building a key from it.
+template <typename K, typename V = NoValue, typename Compare = std::less<K>>
 struct BinaryTree {
     // -----------------------------------------------------------------------------
     // Static methods, associated structs, and constants.
     // -----------------------------------------------------------------------------
+    // Nodes refer to their children by 32-bit indices into the tree memory, which keeps them small
+    // (20 bytes for 32-bit keys) so that a cache line holds several of them.
     struct Node {
-        ptrdiff_t left_node_idx  = LEAF_NODE;
-        ptrdiff_t right_node_idx = LEAF_NODE;
-        T         value;
+        int32_t left_node_idx  = LEAF_NODE;
+        int32_t right_node_idx = LEAF_NODE;
+        // Height of the subtree rooted at this node, leaves have height 1.
+        int32_t height = 1;
+        // Count of keys in the subtree rooted at this node, used for order statistics.
+        int32_t subtree_size = 1;
+        K       key;
     };
 
-    enum struct ChildSide {
-        LEFT = 0,
-        RIGHT,
-    };
+    static constexpr bool HAS_VALUES = !std::is_same_v<V, NoValue>;
 
-    struct NodeSearchResult {
-        ptrdiff_t parent_of_node_idx = INVALID_NODE_INDEX;
-        ptrdiff_t node_idx           = INVALID_NODE_INDEX;
-        ChildSide side_wrt_parent;
-    };
+    static constexpr bool IS_TRANSPARENT = requires { typename Compare::is_transparent; };
 
-    // Enough space a pair of nodes (2) and their child nodes (4).
-    static constexpr size_t MIN_NEW_NODE_BLOCK = 6;
+    // Type lookups compare the keys with, given the type of the key they're asked for: keys of other
+    // types are converted to K unless the comparator is transparent.
+    template <typename KeyLike>
+    using LookupKey = std::conditional_t<IS_TRANSPARENT, KeyLike, K>;
 
-    static constexpr T INVALID_VALUE = std::numeric_limits<T>::max();
+    static constexpr size_t MAX_NODE_COUNT = static_cast<size_t>(std::numeric_limits<int32_t>::max());
 
-    static constexpr ptrdiff_t ROOT_NODE           = 0;
-    static constexpr ptrdiff_t LEAF_NODE           = -1;
-    static constexpr ptrdiff_t NODE_ALREADY_EXISTS = -2;
-    static constexpr ptrdiff_t INVALID_NODE_INDEX  = -3;
+    // An AVL tree of 2^31 nodes is at most 45 levels deep, so paths from the root always fit.
+    static constexpr size_t MAX_PATH_LENGTH = 64;
 
-    static constexpr ptrdiff_t parent_of_child_node(ptrdiff_t child_node_idx) {
-        return (child_node_idx & 0b1) ? (child_node_idx / 2) - 1 : (child_node_idx - 1) / 2;
-    }
+    // Count of lookups of a batch that descend the tree together, so that their cache misses overlap.
+    static constexpr size_t BATCH_LOOKUPS_IN_FLIGHT = 16;
 
-    static constexpr ptrdiff_t left_child_index_from_node(ptrdiff_t current_node_idx) {
-        return 2 * current_node_idx + 1;
-    }
+    // Subtrees with fewer values than this are bulk built by a single thread.
+    static constexpr size_t MIN_PARALLEL_BULK_BUILD_COUNT = size_t{1} << 16;
+
+    // Set operations on subtrees with fewer keys than this, both operands together, run on a single
+    // thread.
+    static constexpr size_t MIN_PARALLEL_SET_OPERATION_COUNT = size_t{1} << 14;
 
-    static constexpr ptrdiff_t right_child_index_from_node(ptrdiff_t current_node_idx) {
-        return 2 * (current_node_idx + 1);
+    // How many levels of recursion to run in parallel so that every hardware thread has a subtree of
+    // its own.
+    static uint32_t max_parallel_depth() {
+        return static_cast<uint32_t>(std::bit_width(max_value(std::thread::hardware_concurrency(), 1u) - 1u));
     }
 
+    // Nodes a set operation dropped from its operands, to be freed once it's done.
+    struct DroppedNodes {
+        std::vector<int32_t> node_indices;
+        std::vector<int32_t> subtree_roots;
+
+        void append(DroppedNodes const& other) {
+            this->node_indices.insert(this->node_indices.end(), other.node_indices.begin(), other.node_indices.end());
+            this->subtree_roots.insert(this->subtree_roots.end(), other.subtree_roots.begin(), other.subtree_roots.end());
+        }
+    };
+
+    static constexpr int32_t LEAF_NODE           = -1;
+    static constexpr int32_t NODE_ALREADY_EXISTS = -2;
+    static constexpr int32_t INVALID_NODE_INDEX  = -3;
+
+    // In-order iterator over the keys. Instead of parent links, it keeps the path of nodes whose
+    // key is yet to be visited in a fixed-size stack, whose top is the current node.
+    //
+    // Iterators are invalidated by any insertion or deletion.
+    struct Iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = K;
+        using difference_type   = ptrdiff_t;
+        using pointer           = K const*;
+        using reference         = K const&;
+
+        BinaryTree const* tree = nullptr;
+        int32_t           stack[MAX_PATH_LENGTH] = {};
+        size_t            stack_length = 0;
+
+        K const& operator*() const {
+            return this->tree->memory[this->stack[this->stack_length - 1]].key;
+        }
+
+        K const* operator->() const {
+            return &**this;
+        }
+
+        V const& value() const
+            requires HAS_VALUES
+        {
+            return this->tree->values[this->stack[this->stack_length - 1]];
+        }
+
+        Iterator& operator++() {
+            int32_t visited_node_idx = this->stack[--this->stack_length];
+            this->push_left_path(this->tree->memory[visited_node_idx].right_node_idx);
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(Iterator const& other) const {
+            if (this->stack_length == 0 || other.stack_length == 0) {
+                return this->stack_length == other.stack_length;
+            }
+            return this->stack[this->stack_length - 1] == other.stack[other.stack_length - 1];
+        }
+
+        // Pushes the node and all of its left descendants, the smallest of which becomes the current
+        // node. The right child of each is prefetched, since it's visited right after it.
+        void push_left_path(int32_t node_idx) {
+            while (node_idx >= 0) {
+                Node const& node = this->tree->memory[node_idx];
+                if (node.right_node_idx >= 0) {
+                    prefetch_read(&this->tree->memory[node.right_node_idx]);
+                }
+
+                assert(this->stack_length < MAX_PATH_LENGTH);
+                this->stack[this->stack_length++] = node_idx;
+                node_idx                          = node.left_node_idx;
+            }
+        }
+    };
+
     // -----------------------------------------------------------------------------
     // Members.
     // -----------------------------------------------------------------------------
 
+    // Nodes are appended densely, the memory never holds more slots than the peak count of keys.
     std::vector<Node> memory;
 
+    // Value of the key of the node of the same index. Empty if the tree has no values.
+    std::vector<V> values;
+
+    // Slots of deleted nodes, reused by the next insertions before growing the memory.
+    std::vector<int32_t> free_node_indices;
+
+    // Roots of whole subtrees dropped by set operations. Their nodes are only pushed to the free
+    // slots as they're needed, a few at a time, so that dropping a subtree costs nothing upfront.
+    std::vector<int32_t> free_subtree_roots;
+
+    // Rotations move nodes around, so the root isn't always the first node.
+    int32_t root_node_idx = LEAF_NODE;
+
+    size_t node_count = 0;
+
+    Compare compare;
+
     // -----------------------------------------------------------------------------
     // Methods.
     // -----------------------------------------------------------------------------
@@ -68,144 +185,978 @@ struct BinaryTree {
     BinaryTree()  = delete;
     ~BinaryTree() = default;
 
-    BinaryTree(T root_value, size_t initial_capacity) {
-        this->memory.reserve(max_value(initial_capacity, MIN_NEW_NODE_BLOCK));
+    BinaryTree(BinaryTree const&)            = default;
+    BinaryTree& operator=(BinaryTree const&) = default;
 
-        // Put space for the two root child nodes.
-        this->memory.resize(MIN_NEW_NODE_BLOCK);
-        this->memory[ROOT_NODE] = {
-            .left_node_idx  = LEAF_NODE,
-            .right_node_idx = LEAF_NODE,
-            .value          = root_value,
-        };
+    // Set operations take their operands by value, so trees must be cheap to move into them.
+    BinaryTree(BinaryTree&&) noexcept            = default;
+    BinaryTree& operator=(BinaryTree&&) noexcept = default;
+
+    BinaryTree(K root_key, size_t initial_capacity, Compare compare = Compare{})
+        : compare{std::move(compare)} {
+        this->memory.reserve(max_value(initial_capacity, size_t{1}));
+        if constexpr (HAS_VALUES) {
+            this->values.reserve(max_value(initial_capacity, size_t{1}));
+        }
+        this->root_node_idx = this->impl_allocate_node(root_key, V{});
+        this->node_count    = 1;
     }
 
-    T min() const {
-        ptrdiff_t current_node_idx = ROOT_NODE;
-        ptrdiff_t next_child_idx   = this->memory[ROOT_NODE].left_node_idx;
+    // Builds a perfectly balanced tree holding the keys, which are sorted and deduplicated first
+    // if they aren't strictly increasing already.
+    //
+    // The nodes are laid out in pre-order: the root of the subtree of the keys [first, last) takes
+    // the first slot of the subtree, followed by the slots of its left and right subtrees. Since the
+    // slots of every subtree are known upfront, large subtrees are built in parallel.
+    explicit BinaryTree(std::span<K const> keys, Compare compare = Compare{})
+        requires(!HAS_VALUES)
+        : compare{std::move(compare)} {
+        if (this->impl_is_strictly_increasing(keys)) {
+            this->impl_build(keys, {});
+            return;
+        }
+
+        std::vector<K> sorted_keys(keys.begin(), keys.end());
+        std::sort(sorted_keys.begin(), sorted_keys.end(), this->compare);
+        sorted_keys.erase(
+            std::unique(sorted_keys.begin(), sorted_keys.end(), [&](K const& lhs, K const& rhs) { return !this->compare(lhs, rhs); }),
+            sorted_keys.end());
+        this->impl_build(sorted_keys, {});
+    }
+
+    // Same as above, the value of a key being the one at the same position. Only the first of the
+    // values of a repeated key is kept.
+    BinaryTree(std::span<K const> keys, std::span<V const> values, Compare compare = Compare{})
+        requires HAS_VALUES
+        : compare{std::move(compare)} {
+        assert(keys.size() == values.size());
+        if (this->impl_is_strictly_increasing(keys)) {
+            this->impl_build(keys, values);
+            return;
+        }
+
+        // Sort the positions rather than the pairs, stably so that the first value of a key comes first.
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), size_t{0});
+        std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return this->compare(keys[lhs], keys[rhs]); });
+        order.erase(
+            std::unique(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return !this->compare(keys[lhs], keys[rhs]); }),
+            order.end());
+
+        std::vector<K> sorted_keys;
+        std::vector<V> sorted_values;
+        sorted_keys.reserve(order.size());
+        sorted_values.reserve(order.size());
+        for (size_t position : order) {
+            sorted_keys.push_back(keys[position]);
+            sorted_values.push_back(values[position]);
+        }
+        this->impl_build(sorted_keys, sorted_values);
+    }
+
+    // Returns the smallest key, or nullptr if the tree is empty.
+    K const* min() const {
+        if (this->root_node_idx == LEAF_NODE) {
+            return nullptr;
+        }
+
+        int32_t current_node_idx = this->root_node_idx;
+        int32_t next_child_idx   = this->memory[current_node_idx].left_node_idx;
         while (next_child_idx >= 0) {
             current_node_idx = next_child_idx;
             next_child_idx   = this->memory[next_child_idx].left_node_idx;
         }
 
-        return this->memory[current_node_idx].value;
+        return &this->memory[current_node_idx].key;
     }
 
-    T max() const {
-        ptrdiff_t current_node_idx = ROOT_NODE;
-        ptrdiff_t next_child_idx   = this->memory[ROOT_NODE].right_node_idx;
+    // Returns the largest key, or nullptr if the tree is empty.
+    K const* max() const {
+        if (this->root_node_idx == LEAF_NODE) {
+            return nullptr;
+        }
+
+        int32_t current_node_idx = this->root_node_idx;
+        int32_t next_child_idx   = this->memory[current_node_idx].right_node_idx;
         while (next_child_idx >= 0) {
             current_node_idx = next_child_idx;
             next_child_idx   = this->memory[next_child_idx].right_node_idx;
         }
 
-        return this->memory[current_node_idx].value;
+        return &this->memory[current_node_idx].key;
     }
 
-    size_t max_depth() const {
-        return impl_max_depth(ROOT_NODE);
+    size_t size() const {
+        return this->node_count;
     }
 
-    ptrdiff_t find_node(T value) const {
-        ptrdiff_t current_node_idx = ROOT_NODE;
+    Iterator begin() const {
+        Iterator it{.tree = this};
+        it.push_left_path(this->root_node_idx);
+        return it;
+    }
+
+    Iterator end() const {
+        return Iterator{.tree = this};
+    }
+
+    // Returns an iterator to the smallest key not less than the given one.
+    template <typename KeyLike>
+    Iterator lower_bound(KeyLike const& key) const {
+        LookupKey<KeyLike> const& lookup_key = key;
+
+        Iterator it{.tree = this};
+
+        int32_t current_node_idx = this->root_node_idx;
         while (current_node_idx >= 0) {
-            Node current_node = this->memory[current_node_idx];
-            if (current_node.value == value) {
-                break;
-            } else if (current_node.value > value) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(current_node.key, lookup_key)) {
+                // Neither this node nor its left subtree are visited.
+                current_node_idx = current_node.right_node_idx;
+            } else {
+                it.stack[it.stack_length++] = current_node_idx;
+                current_node_idx            = current_node.left_node_idx;
+            }
+        }
+
+        return it;
+    }
+
+    // Returns the k-th smallest key, counting from zero, or nullptr if k isn't less than the size of
+    // the tree.
+    K const* select(size_t k) const {
+        if (k >= this->node_count) {
+            return nullptr;
+        }
+
+        int32_t current_node_idx = this->root_node_idx;
+        while (true) {
+            Node const& current_node = this->memory[current_node_idx];
+            size_t      left_size    = static_cast<size_t>(this->impl_subtree_size(current_node.left_node_idx));
+            if (k < left_size) {
                 current_node_idx = current_node.left_node_idx;
+            } else if (k == left_size) {
+                return &current_node.key;
             } else {
+                k               -= left_size + 1;
                 current_node_idx = current_node.right_node_idx;
             }
         }
+    }
+
+    // Returns the count of keys less than the given one.
+    template <typename KeyLike>
+    size_t rank(KeyLike const& key) const {
+        LookupKey<KeyLike> const& lookup_key = key;
+
+        size_t  less_count       = 0;
+        int32_t current_node_idx = this->root_node_idx;
+        while (current_node_idx >= 0) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(current_node.key, lookup_key)) {
+                less_count      += static_cast<size_t>(this->impl_subtree_size(current_node.left_node_idx)) + 1;
+                current_node_idx = current_node.right_node_idx;
+            } else {
+                current_node_idx = current_node.left_node_idx;
+            }
+        }
+        return less_count;
+    }
+
+    // Calls the visitor with each key in [low, high), in ascending order.
+    template <typename KeyLike, typename Visitor>
+    void range(KeyLike const& low, KeyLike const& high, Visitor&& visitor) const {
+        LookupKey<KeyLike> const& high_key = high;
+        for (Iterator it = this->lower_bound(low); it.stack_length > 0 && this->compare(*it, high_key); ++it) {
+            visitor(*it);
+        }
+    }
+
+    size_t max_depth() const {
+        return static_cast<size_t>(this->impl_height(this->root_node_idx));
+    }
+
+    template <typename KeyLike>
+    int32_t find_node(KeyLike const& key) const {
+        LookupKey<KeyLike> const& lookup_key = key;
+
+        int32_t current_node_idx = this->root_node_idx;
+        while (current_node_idx >= 0) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(lookup_key, current_node.key)) {
+                current_node_idx = current_node.left_node_idx;
+            } else if (this->compare(current_node.key, lookup_key)) {
+                current_node_idx = current_node.right_node_idx;
+            } else {
+                break;
+            }
+        }
 
         return (current_node_idx >= 0) ? current_node_idx : INVALID_NODE_INDEX;
     }
 
-    ptrdiff_t insert_node(T value) {
-        NodeSearchResult traversal_result;
-        this->impl_traverse_to_node_index(traversal_result, value, ROOT_NODE);
+    // Returns the value of the key, or nullptr if it isn't in the tree.
+    template <typename KeyLike>
+    V* find_value(KeyLike const& key)
+        requires HAS_VALUES
+    {
+        int32_t node_idx = this->find_node(key);
+        return (node_idx >= 0) ? &this->values[static_cast<size_t>(node_idx)] : nullptr;
+    }
+
+    template <typename KeyLike>
+    V const* find_value(KeyLike const& key) const
+        requires HAS_VALUES
+    {
+        int32_t node_idx = this->find_node(key);
+        return (node_idx >= 0) ? &this->values[static_cast<size_t>(node_idx)] : nullptr;
+    }
+
+    // Writes the index of the node of each key, or INVALID_NODE_INDEX if it isn't in the tree, to the
+    // slot of the same position in the output.
+    //
+    // Rather than finding the keys one after the other, where every level is a cache miss that
+    // must be waited for, up to BATCH_LOOKUPS_IN_FLIGHT lookups are interleaved: each one goes down
+    // a single level and prefetches its next node before handing over to the next lookup, which
+    // gives the prefetches time to complete. Finished lookups are replaced by the next key.
+    void find_batch(std::span<K const> keys, std::span<int32_t> node_indices) const {
+        assert(node_indices.size() >= keys.size());
+
+        struct Lookup {
+            size_t  key_idx;
+            int32_t node_idx;
+        };
+
+        Lookup lookups[BATCH_LOOKUPS_IN_FLIGHT];
+        size_t lookup_count = 0;
+        size_t next_key_idx = 0;
+        while (lookup_count < BATCH_LOOKUPS_IN_FLIGHT && next_key_idx < keys.size()) {
+            lookups[lookup_count++] = {.key_idx = next_key_idx++, .node_idx = this->root_node_idx};
+        }
+
+        while (lookup_count > 0) {
+            size_t lookup_idx = 0;
+            while (lookup_idx < lookup_count) {
+                Lookup&  lookup     = lookups[lookup_idx];
+                K const& key        = keys[lookup.key_idx];
+                int32_t  found_node = INVALID_NODE_INDEX;
+                bool     finished   = true;
+
+                if (lookup.node_idx >= 0) {
+                    Node const& node = this->memory[lookup.node_idx];
+                    bool        less = this->compare(key, node.key);
+                    if (!less && !this->compare(node.key, key)) {
+                        found_node = lookup.node_idx;
+                    } else {
+                        int32_t child_idx = less ? node.left_node_idx : node.right_node_idx;
+                        if (child_idx >= 0) {
+                            prefetch_read(&this->memory[child_idx]);
+                            lookup.node_idx = child_idx;
+                            finished        = false;
+                        }
+                    }
+                }
+
+                if (!finished) {
+                    ++lookup_idx;
+                    continue;
+                }
+
+                node_indices[lookup.key_idx] = found_node;
+                if (next_key_idx < keys.size()) {
+                    lookup = {.key_idx = next_key_idx++, .node_idx = this->root_node_idx};
+                    ++lookup_idx;
+                } else {
+                    // Take the last lookup in place of the finished one.
+                    lookup = lookups[--lookup_count];
+                }
+            }
+        }
+    }
+
+    // Returns the index of the new node, or NODE_ALREADY_EXISTS if the key is already in the tree, in
+    // which case its value is left as is.
+    int32_t insert_node(K const& key, V value = V{}) {
+        int32_t path[MAX_PATH_LENGTH];
+        size_t  path_length = 0;
 
-        if (traversal_result.node_idx == NODE_ALREADY_EXISTS) {
-            // Do nothing.
-        } else if (traversal_result.parent_of_node_idx == INVALID_NODE_INDEX) {
-            // The only node whose parent doesn't exist is the root.
-            if (this->memory[ROOT_NODE].value != value) {
-                this->memory[ROOT_NODE].value = value;
+        int32_t current_node_idx = this->root_node_idx;
+        while (current_node_idx >= 0) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(key, current_node.key)) {
+                path[path_length++] = current_node_idx;
+                current_node_idx    = current_node.left_node_idx;
+            } else if (this->compare(current_node.key, key)) {
+                path[path_length++] = current_node_idx;
+                current_node_idx    = current_node.right_node_idx;
             } else {
-                traversal_result.node_idx = NODE_ALREADY_EXISTS;
+                return NODE_ALREADY_EXISTS;
             }
+        }
+
+        // @NOTE: Allocating may grow the memory, so don't hold references to nodes across it.
+        int32_t new_node_idx = this->impl_allocate_node(key, std::move(value));
+        this->node_count += 1;
+
+        if (path_length == 0) {
+            this->root_node_idx = new_node_idx;
         } else {
-            if (traversal_result.node_idx >= static_cast<ptrdiff_t>(this->memory.size())) {
-                this->memory.resize(static_cast<size_t>(traversal_result.node_idx) + MIN_NEW_NODE_BLOCK);
+            Node& parent_node = this->memory[path[path_length - 1]];
+            if (this->compare(key, parent_node.key)) {
+                parent_node.left_node_idx = new_node_idx;
+            } else {
+                parent_node.right_node_idx = new_node_idx;
             }
+        }
+
+        this->impl_rebalance_path(path, path_length);
+        return new_node_idx;
+    }
+
+    // Returns whether the key was in the tree. The indices of the remaining nodes don't change, the
+    // slot of the deleted node is reused by a later insertion.
+    template <typename KeyLike>
+    bool delete_node(KeyLike const& key) {
+        LookupKey<KeyLike> const& lookup_key = key;
 
-            Node& new_node    = this->memory[traversal_result.node_idx];
-            Node& parent_node = this->memory[traversal_result.parent_of_node_idx];
+        int32_t path[MAX_PATH_LENGTH];
+        size_t  path_length = 0;
 
-            switch (traversal_result.side_wrt_parent) {
-                case ChildSide::LEFT:  parent_node.left_node_idx = traversal_result.node_idx; break;
-                case ChildSide::RIGHT: parent_node.right_node_idx = traversal_result.node_idx; break;
+        int32_t deleted_node_idx = this->root_node_idx;
+        while (deleted_node_idx >= 0) {
+            Node const& current_node = this->memory[deleted_node_idx];
+            if (this->compare(lookup_key, current_node.key)) {
+                path[path_length++] = deleted_node_idx;
+                deleted_node_idx    = current_node.left_node_idx;
+            } else if (this->compare(current_node.key, lookup_key)) {
+                path[path_length++] = deleted_node_idx;
+                deleted_node_idx    = current_node.right_node_idx;
+            } else {
+                break;
             }
+        }
+
+        if (deleted_node_idx < 0) {
+            return false;
+        }
+
+        int32_t parent_node_idx = (path_length > 0) ? path[path_length - 1] : LEAF_NODE;
+        Node&   deleted_node    = this->memory[deleted_node_idx];
+
+        int32_t replacement_node_idx;
+        if (deleted_node.left_node_idx == LEAF_NODE) {
+            replacement_node_idx = deleted_node.right_node_idx;
+        } else if (deleted_node.right_node_idx == LEAF_NODE) {
+            replacement_node_idx = deleted_node.left_node_idx;
+        } else {
+            // Put the successor node in place of the deleted one, rather than copying its key, so
+            // that the indices of the remaining keys stay valid. The successor takes the place
+            // of the deleted node in the path too, since it's the one to rebalance there.
+            size_t deleted_path_idx = path_length;
+            path[path_length++]     = deleted_node_idx;
+
+            int32_t successor_idx = deleted_node.right_node_idx;
+            while (this->memory[successor_idx].left_node_idx >= 0) {
+                path[path_length++] = successor_idx;
+                successor_idx       = this->memory[successor_idx].left_node_idx;
+            }
+
+            Node& successor_node = this->memory[successor_idx];
+            this->impl_replace_child(path[path_length - 1], successor_idx, successor_node.right_node_idx);
+
+            successor_node.left_node_idx  = deleted_node.left_node_idx;
+            successor_node.right_node_idx = deleted_node.right_node_idx;
+            successor_node.height         = deleted_node.height;
+            successor_node.subtree_size   = deleted_node.subtree_size;
+            path[deleted_path_idx]        = successor_idx;
+            replacement_node_idx          = successor_idx;
+        }
+
+        this->impl_replace_child(parent_node_idx, deleted_node_idx, replacement_node_idx);
+        if constexpr (HAS_VALUES) {
+            // Release what the value holds now rather than when the slot is reused.
+            this->values[static_cast<size_t>(deleted_node_idx)] = V{};
+        }
+        this->free_node_indices.push_back(deleted_node_idx);
+        this->node_count -= 1;
+
+        this->impl_rebalance_path(path, path_length);
+        return true;
+    }
+
+    // Moves the keys not less than the given one out to a new tree, leaving the smaller ones. Costs
+    // O(log n) to split the tree, plus the size of the part moved out to copy it.
+    template <typename KeyLike>
+    BinaryTree split(KeyLike const& key) {
+        LookupKey<KeyLike> const& lookup_key = key;
+
+        auto [less_root_idx, found_node_idx, greater_root_idx] = this->impl_split(this->root_node_idx, lookup_key);
+        if (found_node_idx >= 0) {
+            greater_root_idx = this->impl_join(LEAF_NODE, found_node_idx, greater_root_idx);
+        }
+
+        BinaryTree greater_tree = this->impl_empty_tree();
+        greater_tree.memory.reserve(static_cast<size_t>(this->impl_subtree_size(greater_root_idx)));
+        greater_tree.root_node_idx = greater_tree.impl_copy_subtree(*this, greater_root_idx);
+        greater_tree.node_count    = static_cast<size_t>(greater_tree.impl_subtree_size(greater_tree.root_node_idx));
+
+        if (greater_root_idx >= 0) {
+            this->free_subtree_roots.push_back(greater_root_idx);
+        }
+        this->root_node_idx = less_root_idx;
+        this->node_count    = static_cast<size_t>(this->impl_subtree_size(less_root_idx));
+        return greater_tree;
+    }
+
+    // Appends the keys of the other tree, which must all be greater than those of this one. The
+    // smaller of the two trees is copied into the other, and the join itself costs O(log n).
+    void join(BinaryTree other) {
+        if (this->root_node_idx >= 0 && other.root_node_idx >= 0) {
+            assert(this->compare(*this->max(), *other.min()));
+        }
+
+        bool        this_is_larger             = this->size() >= other.size();
+        auto [left_root_idx, right_root_idx]   = impl_merge_memories(*this, other);
+        BinaryTree& result                     = this_is_larger ? *this : other;
 
-            new_node.value = value;
+        int32_t joined_root_idx = result.impl_join_pair(left_root_idx, right_root_idx);
+        result.root_node_idx    = joined_root_idx;
+        result.node_count       = static_cast<size_t>(result.impl_subtree_size(joined_root_idx));
+        if (!this_is_larger) {
+            *this = std::move(other);
         }
+    }
+
+    // The set operations below run in O(m log(n/m + 1)), for trees of sizes m <= n, as in "Just Join
+    // for Parallel Ordered Sets" (Blelloch, Ferizovic & Sun): the smaller tree is copied into the
+    // larger one, whose nodes are then split and joined in place. Both halves of each split are
+    // processed in parallel down to subtrees of MIN_PARALLEL_SET_OPERATION_COUNT keys, since they
+    // touch disjoint nodes.
+    //
+    // Keys present in both trees keep the value they have in the left hand side one.
 
-        return traversal_result.node_idx;
+    static BinaryTree set_union(BinaryTree lhs, BinaryTree rhs) {
+        return impl_set_operation(std::move(lhs), std::move(rhs), [](BinaryTree& tree, int32_t lhs_root_idx, int32_t rhs_root_idx, DroppedNodes& dropped) {
+            return tree.impl_union(lhs_root_idx, rhs_root_idx, max_parallel_depth(), dropped);
+        });
+    }
+
+    static BinaryTree set_intersection(BinaryTree lhs, BinaryTree rhs) {
+        return impl_set_operation(std::move(lhs), std::move(rhs), [](BinaryTree& tree, int32_t lhs_root_idx, int32_t rhs_root_idx, DroppedNodes& dropped) {
+            return tree.impl_intersection(lhs_root_idx, rhs_root_idx, max_parallel_depth(), dropped);
+        });
+    }
+
+    // Keys of the left hand side tree that aren't in the right hand side one.
+    static BinaryTree set_difference(BinaryTree lhs, BinaryTree rhs) {
+        return impl_set_operation(std::move(lhs), std::move(rhs), [](BinaryTree& tree, int32_t lhs_root_idx, int32_t rhs_root_idx, DroppedNodes& dropped) {
+            return tree.impl_difference(lhs_root_idx, rhs_root_idx, max_parallel_depth(), dropped);
+        });
     }
 
     // -----------------------------------------------------------------------------
     // Implementation details.
     // -----------------------------------------------------------------------------
 
-    // @NOTE: Bad and inefficient.
-    size_t impl_max_depth(ptrdiff_t current_node_idx) const {
-        if (current_node_idx < 0) {
-            return 0;
+    int32_t impl_allocate_node(K const& key, V value) {
+        Node new_node = {
+            .left_node_idx  = LEAF_NODE,
+            .right_node_idx = LEAF_NODE,
+            .height         = 1,
+            .subtree_size   = 1,
+            .key            = key,
+        };
+
+        if (this->free_node_indices.empty() && !this->free_subtree_roots.empty()) {
+            int32_t subtree_root_idx = this->free_subtree_roots.back();
+            this->free_subtree_roots.pop_back();
+
+            Node const& subtree_root = this->memory[subtree_root_idx];
+            if (subtree_root.left_node_idx >= 0) {
+                this->free_subtree_roots.push_back(subtree_root.left_node_idx);
+            }
+            if (subtree_root.right_node_idx >= 0) {
+                this->free_subtree_roots.push_back(subtree_root.right_node_idx);
+            }
+            this->free_node_indices.push_back(subtree_root_idx);
         }
 
-        Node const& current_node = this->memory[current_node_idx];
-        return 1u + std::max(impl_max_depth(current_node.left_node_idx), impl_max_depth(current_node.right_node_idx));
+        if (!this->free_node_indices.empty()) {
+            int32_t node_idx = this->free_node_indices.back();
+            this->free_node_indices.pop_back();
+            this->memory[node_idx] = std::move(new_node);
+            if constexpr (HAS_VALUES) {
+                this->values[node_idx] = std::move(value);
+            }
+            return node_idx;
+        }
+
+        assert(this->memory.size() < MAX_NODE_COUNT);
+        this->memory.push_back(std::move(new_node));
+        if constexpr (HAS_VALUES) {
+            this->values.push_back(std::move(value));
+        }
+        return static_cast<int32_t>(this->memory.size() - 1);
     }
 
-    void impl_traverse_to_node_index(NodeSearchResult& result, T value, ptrdiff_t current_node_idx) {
-        assert(current_node_idx != LEAF_NODE);
+    bool impl_is_strictly_increasing(std::span<K const> keys) const {
+        auto not_less = [&](K const& lhs, K const& rhs) { return !this->compare(lhs, rhs); };
+        return std::adjacent_find(keys.begin(), keys.end(), not_less) == keys.end();
+    }
 
-        if (current_node_idx >= static_cast<ptrdiff_t>(this->memory.size())) {
-            // If the node doesn't even exist, then it surely is a vacant leaf.
-            result.node_idx = current_node_idx;
-            return;
+    // The values are either empty or as many as the keys.
+    void impl_build(std::span<K const> sorted_keys, std::span<V const> sorted_values) {
+        assert(sorted_keys.size() <= MAX_NODE_COUNT);
+        this->memory.resize(sorted_keys.size());
+        if constexpr (HAS_VALUES) {
+            this->values.resize(sorted_keys.size());
         }
+        this->node_count = sorted_keys.size();
 
-        Node node = this->memory[current_node_idx];
+        this->root_node_idx = this->impl_bulk_build(sorted_keys, sorted_values, 0, max_parallel_depth());
+    }
+
+    // Builds the subtree of the sorted keys in the slots starting at the given one, returning its root.
+    int32_t impl_bulk_build(std::span<K const> sorted_keys, std::span<V const> sorted_values, int32_t first_node_idx, uint32_t parallel_depth) {
+        if (sorted_keys.empty()) {
+            return LEAF_NODE;
+        }
 
-        ptrdiff_t next_child_idx = INVALID_NODE_INDEX;
+        size_t  mid_idx         = sorted_keys.size() / 2;
+        int32_t left_first_idx  = first_node_idx + 1;
+        int32_t right_first_idx = left_first_idx + static_cast<int32_t>(mid_idx);
 
-        if (node.value == value) {
-            result.node_idx = NODE_ALREADY_EXISTS;
-        } else if (value < node.value) {
-            if (node.left_node_idx == LEAF_NODE) {
-                // Success found to the left of the current node.
-                result.parent_of_node_idx = current_node_idx;
-                result.node_idx           = this->left_child_index_from_node(current_node_idx);
-                result.side_wrt_parent    = ChildSide::LEFT;
-            } else {
-                next_child_idx = node.left_node_idx;
+        std::span<K const> left_keys    = sorted_keys.first(mid_idx);
+        std::span<K const> right_keys   = sorted_keys.subspan(mid_idx + 1);
+        std::span<V const> left_values  = HAS_VALUES ? sorted_values.first(mid_idx) : sorted_values;
+        std::span<V const> right_values = HAS_VALUES ? sorted_values.subspan(mid_idx + 1) : sorted_values;
+
+        int32_t left_node_idx  = LEAF_NODE;
+        int32_t right_node_idx = LEAF_NODE;
+        if (parallel_depth > 0 && sorted_keys.size() >= MIN_PARALLEL_BULK_BUILD_COUNT) {
+            // Both subtrees write to disjoint slots of the memory.
+            std::thread left_builder{[&]() {
+                left_node_idx = this->impl_bulk_build(left_keys, left_values, left_first_idx, parallel_depth - 1);
+            }};
+            right_node_idx = this->impl_bulk_build(right_keys, right_values, right_first_idx, parallel_depth - 1);
+            left_builder.join();
+        } else {
+            left_node_idx  = this->impl_bulk_build(left_keys, left_values, left_first_idx, 0);
+            right_node_idx = this->impl_bulk_build(right_keys, right_values, right_first_idx, 0);
+        }
+
+        this->memory[first_node_idx] = {
+            .left_node_idx  = left_node_idx,
+            .right_node_idx = right_node_idx,
+            .height         = 1 + std::max(this->impl_height(left_node_idx), this->impl_height(right_node_idx)),
+            .subtree_size   = static_cast<int32_t>(sorted_keys.size()),
+            .key            = sorted_keys[mid_idx],
+        };
+        if constexpr (HAS_VALUES) {
+            this->values[first_node_idx] = sorted_values[mid_idx];
+        }
+        return first_node_idx;
+    }
+
+    BinaryTree impl_empty_tree() const {
+        if constexpr (HAS_VALUES) {
+            return BinaryTree{std::span<K const>{}, std::span<V const>{}, this->compare};
+        } else {
+            return BinaryTree{std::span<K const>{}, this->compare};
+        }
+    }
+
+    // Copies the subtree of the other tree, returning the index of its root in this one.
+    int32_t impl_copy_subtree(BinaryTree const& source, int32_t source_node_idx) {
+        if (source_node_idx < 0) {
+            return LEAF_NODE;
+        }
+
+        Node const& source_node = source.memory[source_node_idx];
+        V           value       = V{};
+        if constexpr (HAS_VALUES) {
+            value = source.values[source_node_idx];
+        }
+
+        // @NOTE: Allocating may grow the memory, so don't hold references to nodes across it.
+        int32_t node_idx       = this->impl_allocate_node(source_node.key, std::move(value));
+        int32_t left_node_idx  = this->impl_copy_subtree(source, source_node.left_node_idx);
+        int32_t right_node_idx = this->impl_copy_subtree(source, source_node.right_node_idx);
+
+        Node& node          = this->memory[node_idx];
+        node.left_node_idx  = left_node_idx;
+        node.right_node_idx = right_node_idx;
+        node.height         = source_node.height;
+        node.subtree_size   = source_node.subtree_size;
+        return node_idx;
+    }
+
+    // Copies the smaller tree into the larger one, returning the roots of both trees in the memory of
+    // the larger one, lhs first.
+    static std::pair<int32_t, int32_t> impl_merge_memories(BinaryTree& lhs, BinaryTree& rhs) {
+        if (lhs.size() >= rhs.size()) {
+            return {lhs.root_node_idx, lhs.impl_copy_subtree(rhs, rhs.root_node_idx)};
+        }
+        return {rhs.impl_copy_subtree(lhs, lhs.root_node_idx), rhs.root_node_idx};
+    }
+
+    template <typename Operation>
+    static BinaryTree impl_set_operation(BinaryTree lhs, BinaryTree rhs, Operation&& operation) {
+        bool        lhs_is_larger             = lhs.size() >= rhs.size();
+        auto [lhs_root_idx, rhs_root_idx]     = impl_merge_memories(lhs, rhs);
+        BinaryTree& result                    = lhs_is_larger ? lhs : rhs;
+
+        DroppedNodes dropped;
+        result.root_node_idx = operation(result, lhs_root_idx, rhs_root_idx, dropped);
+        result.node_count    = static_cast<size_t>(result.impl_subtree_size(result.root_node_idx));
+        result.impl_free_dropped(dropped);
+        return std::move(result);
+    }
+
+    void impl_free_dropped(DroppedNodes const& dropped) {
+        for (int32_t node_idx : dropped.node_indices) {
+            if constexpr (HAS_VALUES) {
+                this->values[static_cast<size_t>(node_idx)] = V{};
             }
+            this->free_node_indices.push_back(node_idx);
+        }
+        this->free_subtree_roots.insert(this->free_subtree_roots.end(), dropped.subtree_roots.begin(), dropped.subtree_roots.end());
+    }
+
+    // Runs both calls in parallel if the subtrees they work on are large enough and there are
+    // threads left for them. The calls are given the parallel depth left for their own calls.
+    template <typename LeftCall, typename RightCall>
+    static void impl_fork_join(size_t key_count, uint32_t parallel_depth, LeftCall&& left_call, RightCall&& right_call) {
+        if (parallel_depth > 0 && key_count >= MIN_PARALLEL_SET_OPERATION_COUNT) {
+            std::thread left_worker{[&]() { left_call(parallel_depth - 1); }};
+            right_call(parallel_depth - 1);
+            left_worker.join();
         } else {
-            if (node.right_node_idx == LEAF_NODE) {
-                // Success found to the right of the current node.
-                result.parent_of_node_idx = current_node_idx;
-                result.node_idx           = this->right_child_index_from_node(current_node_idx);
-                result.side_wrt_parent    = ChildSide::RIGHT;
-            } else {
-                next_child_idx = node.right_node_idx;
+            left_call(0u);
+            right_call(0u);
+        }
+    }
+
+    // Splits the subtree by the key into the subtrees of the keys less and greater than it, and the
+    // node of the key itself if it's there. Reuses the nodes of the subtree.
+    template <typename KeyLike>
+    std::tuple<int32_t, int32_t, int32_t> impl_split(int32_t node_idx, KeyLike const& key) {
+        if (node_idx < 0) {
+            return {LEAF_NODE, LEAF_NODE, LEAF_NODE};
+        }
+
+        Node const& node           = this->memory[node_idx];
+        int32_t     left_node_idx  = node.left_node_idx;
+        int32_t     right_node_idx = node.right_node_idx;
+        if (this->compare(key, node.key)) {
+            auto [less_root_idx, found_node_idx, greater_root_idx] = this->impl_split(left_node_idx, key);
+            return {less_root_idx, found_node_idx, this->impl_join(greater_root_idx, node_idx, right_node_idx)};
+        }
+        if (this->compare(node.key, key)) {
+            auto [less_root_idx, found_node_idx, greater_root_idx] = this->impl_split(right_node_idx, key);
+            return {this->impl_join(left_node_idx, node_idx, less_root_idx), found_node_idx, greater_root_idx};
+        }
+        return {left_node_idx, node_idx, right_node_idx};
+    }
+
+    // Joins the subtrees with the middle node in between, every key of the left subtree being less
+    // than that of the node, itself less than every key of the right subtree. Returns the new root.
+    //
+    // The shorter subtree is hung from the spine of the taller one at the level of its height, and
+    // rotations on the way back up restore the balance, in O(difference of heights).
+    int32_t impl_join(int32_t left_root_idx, int32_t middle_node_idx, int32_t right_root_idx) {
+        int32_t left_height  = this->impl_height(left_root_idx);
+        int32_t right_height = this->impl_height(right_root_idx);
+        if (left_height > right_height + 1) {
+            return this->impl_join_right(left_root_idx, middle_node_idx, right_root_idx);
+        }
+        if (right_height > left_height + 1) {
+            return this->impl_join_left(left_root_idx, middle_node_idx, right_root_idx);
+        }
+
+        Node& middle_node          = this->memory[middle_node_idx];
+        middle_node.left_node_idx  = left_root_idx;
+        middle_node.right_node_idx = right_root_idx;
+        this->impl_update_node(middle_node_idx);
+        return middle_node_idx;
+    }
+
+    // Joins along the right spine of the left subtree, which is the taller one.
+    int32_t impl_join_right(int32_t left_root_idx, int32_t middle_node_idx, int32_t right_root_idx) {
+        Node&   left_root       = this->memory[left_root_idx];
+        int32_t inner_child_idx = left_root.right_node_idx;
+
+        if (this->impl_height(inner_child_idx) <= this->impl_height(right_root_idx) + 1) {
+            Node& middle_node          = this->memory[middle_node_idx];
+            middle_node.left_node_idx  = inner_child_idx;
+            middle_node.right_node_idx = right_root_idx;
+            this->impl_update_node(middle_node_idx);
+
+            if (this->impl_height(middle_node_idx) <= this->impl_height(left_root.left_node_idx) + 1) {
+                left_root.right_node_idx = middle_node_idx;
+                this->impl_update_node(left_root_idx);
+                return left_root_idx;
+            }
+            left_root.right_node_idx = this->impl_rotate_right(middle_node_idx);
+            this->impl_update_node(left_root_idx);
+            return this->impl_rotate_left(left_root_idx);
+        }
+
+        int32_t new_right_idx    = this->impl_join_right(inner_child_idx, middle_node_idx, right_root_idx);
+        left_root.right_node_idx = new_right_idx;
+        this->impl_update_node(left_root_idx);
+        if (this->impl_height(new_right_idx) <= this->impl_height(left_root.left_node_idx) + 1) {
+            return left_root_idx;
+        }
+        return this->impl_rotate_left(left_root_idx);
+    }
+
+    // Joins along the left spine of the right subtree, which is the taller one.
+    int32_t impl_join_left(int32_t left_root_idx, int32_t middle_node_idx, int32_t right_root_idx) {
+        Node&   right_root      = this->memory[right_root_idx];
+        int32_t inner_child_idx = right_root.left_node_idx;
+
+        if (this->impl_height(inner_child_idx) <= this->impl_height(left_root_idx) + 1) {
+            Node& middle_node          = this->memory[middle_node_idx];
+            middle_node.left_node_idx  = left_root_idx;
+            middle_node.right_node_idx = inner_child_idx;
+            this->impl_update_node(middle_node_idx);
+
+            if (this->impl_height(middle_node_idx) <= this->impl_height(right_root.right_node_idx) + 1) {
+                right_root.left_node_idx = middle_node_idx;
+                this->impl_update_node(right_root_idx);
+                return right_root_idx;
+            }
+            right_root.left_node_idx = this->impl_rotate_left(middle_node_idx);
+            this->impl_update_node(right_root_idx);
+            return this->impl_rotate_right(right_root_idx);
+        }
+
+        int32_t new_left_idx     = this->impl_join_left(left_root_idx, middle_node_idx, inner_child_idx);
+        right_root.left_node_idx = new_left_idx;
+        this->impl_update_node(right_root_idx);
+        if (this->impl_height(new_left_idx) <= this->impl_height(right_root.right_node_idx) + 1) {
+            return right_root_idx;
+        }
+        return this->impl_rotate_right(right_root_idx);
+    }
+
+    // Joins two subtrees without a middle node, using the largest node of the left one as such.
+    int32_t impl_join_pair(int32_t left_root_idx, int32_t right_root_idx) {
+        if (left_root_idx < 0) {
+            return right_root_idx;
+        }
+
+        auto [rest_root_idx, last_node_idx] = this->impl_split_last(left_root_idx);
+        return this->impl_join(rest_root_idx, last_node_idx, right_root_idx);
+    }
+
+    // Unlinks the largest node of the non-empty subtree, returning the rest of it and that node.
+    std::pair<int32_t, int32_t> impl_split_last(int32_t node_idx) {
+        Node const& node = this->memory[node_idx];
+        if (node.right_node_idx < 0) {
+            return {node.left_node_idx, node_idx};
+        }
+
+        int32_t left_node_idx                = node.left_node_idx;
+        auto [rest_root_idx, last_node_idx] = this->impl_split_last(node.right_node_idx);
+        return {this->impl_join(left_node_idx, node_idx, rest_root_idx), last_node_idx};
+    }
+
+    int32_t impl_union(int32_t lhs_root_idx, int32_t rhs_root_idx, uint32_t parallel_depth, DroppedNodes& dropped) {
+        if (lhs_root_idx < 0) {
+            return rhs_root_idx;
+        }
+        if (rhs_root_idx < 0) {
+            return lhs_root_idx;
+        }
+
+        Node const& lhs_root        = this->memory[lhs_root_idx];
+        int32_t     lhs_left_idx    = lhs_root.left_node_idx;
+        int32_t     lhs_right_idx   = lhs_root.right_node_idx;
+        size_t      key_count       = static_cast<size_t>(lhs_root.subtree_size + this->impl_subtree_size(rhs_root_idx));
+        auto [rhs_less_idx, rhs_found_idx, rhs_greater_idx] = this->impl_split(rhs_root_idx, lhs_root.key);
+        if (rhs_found_idx >= 0) {
+            dropped.node_indices.push_back(rhs_found_idx);
+        }
+
+        int32_t      left_union_idx  = LEAF_NODE;
+        int32_t      right_union_idx = LEAF_NODE;
+        DroppedNodes left_dropped;
+        impl_fork_join(
+            key_count,
+            parallel_depth,
+            [&](uint32_t child_parallel_depth) { left_union_idx = this->impl_union(lhs_left_idx, rhs_less_idx, child_parallel_depth, left_dropped); },
+            [&](uint32_t child_parallel_depth) { right_union_idx = this->impl_union(lhs_right_idx, rhs_greater_idx, child_parallel_depth, dropped); });
+        dropped.append(left_dropped);
+
+        return this->impl_join(left_union_idx, lhs_root_idx, right_union_idx);
+    }
+
+    int32_t impl_intersection(int32_t lhs_root_idx, int32_t rhs_root_idx, uint32_t parallel_depth, DroppedNodes& dropped) {
+        if (lhs_root_idx < 0 || rhs_root_idx < 0) {
+            if (lhs_root_idx >= 0) {
+                dropped.subtree_roots.push_back(lhs_root_idx);
+            }
+            if (rhs_root_idx >= 0) {
+                dropped.subtree_roots.push_back(rhs_root_idx);
+            }
+            return LEAF_NODE;
+        }
+
+        Node const& lhs_root      = this->memory[lhs_root_idx];
+        int32_t     lhs_left_idx  = lhs_root.left_node_idx;
+        int32_t     lhs_right_idx = lhs_root.right_node_idx;
+        size_t      key_count     = static_cast<size_t>(lhs_root.subtree_size + this->impl_subtree_size(rhs_root_idx));
+        auto [rhs_less_idx, rhs_found_idx, rhs_greater_idx] = this->impl_split(rhs_root_idx, lhs_root.key);
+
+        int32_t      left_intersection_idx  = LEAF_NODE;
+        int32_t      right_intersection_idx = LEAF_NODE;
+        DroppedNodes left_dropped;
+        impl_fork_join(
+            key_count,
+            parallel_depth,
+            [&](uint32_t child_parallel_depth) { left_intersection_idx = this->impl_intersection(lhs_left_idx, rhs_less_idx, child_parallel_depth, left_dropped); },
+            [&](uint32_t child_parallel_depth) { right_intersection_idx = this->impl_intersection(lhs_right_idx, rhs_greater_idx, child_parallel_depth, dropped); });
+        dropped.append(left_dropped);
+
+        if (rhs_found_idx >= 0) {
+            dropped.node_indices.push_back(rhs_found_idx);
+            return this->impl_join(left_intersection_idx, lhs_root_idx, right_intersection_idx);
+        }
+        dropped.node_indices.push_back(lhs_root_idx);
+        return this->impl_join_pair(left_intersection_idx, right_intersection_idx);
+    }
+
+    int32_t impl_difference(int32_t lhs_root_idx, int32_t rhs_root_idx, uint32_t parallel_depth, DroppedNodes& dropped) {
+        if (lhs_root_idx < 0 || rhs_root_idx < 0) {
+            if (rhs_root_idx >= 0) {
+                dropped.subtree_roots.push_back(rhs_root_idx);
+            }
+            return lhs_root_idx;
+        }
+
+        // Split the left hand side by the keys of the right hand side one, whose nodes all go.
+        Node const& rhs_root      = this->memory[rhs_root_idx];
+        int32_t     rhs_left_idx  = rhs_root.left_node_idx;
+        int32_t     rhs_right_idx = rhs_root.right_node_idx;
+        size_t      key_count     = static_cast<size_t>(rhs_root.subtree_size + this->impl_subtree_size(lhs_root_idx));
+        auto [lhs_less_idx, lhs_found_idx, lhs_greater_idx] = this->impl_split(lhs_root_idx, rhs_root.key);
+        dropped.node_indices.push_back(rhs_root_idx);
+        if (lhs_found_idx >= 0) {
+            dropped.node_indices.push_back(lhs_found_idx);
+        }
+
+        int32_t      left_difference_idx  = LEAF_NODE;
+        int32_t      right_difference_idx = LEAF_NODE;
+        DroppedNodes left_dropped;
+        impl_fork_join(
+            key_count,
+            parallel_depth,
+            [&](uint32_t child_parallel_depth) { left_difference_idx = this->impl_difference(lhs_less_idx, rhs_left_idx, child_parallel_depth, left_dropped); },
+            [&](uint32_t child_parallel_depth) { right_difference_idx = this->impl_difference(lhs_greater_idx, rhs_right_idx, child_parallel_depth, dropped); });
+        dropped.append(left_dropped);
+
+        return this->impl_join_pair(left_difference_idx, right_difference_idx);
+    }
+
+    int32_t impl_height(int32_t node_idx) const {
+        return (node_idx >= 0) ? this->memory[node_idx].height : 0;
+    }
+
+    int32_t impl_subtree_size(int32_t node_idx) const {
+        return (node_idx >= 0) ? this->memory[node_idx].subtree_size : 0;
+    }
+
+    // Recomputes the height and size of the subtree of the node from those of its children.
+    void impl_update_node(int32_t node_idx) {
+        Node& node        = this->memory[node_idx];
+        node.height       = 1 + std::max(this->impl_height(node.left_node_idx), this->impl_height(node.right_node_idx));
+        node.subtree_size = 1 + this->impl_subtree_size(node.left_node_idx) + this->impl_subtree_size(node.right_node_idx);
+    }
+
+    int32_t impl_balance_factor(int32_t node_idx) const {
+        Node const& node = this->memory[node_idx];
+        return this->impl_height(node.left_node_idx) - this->impl_height(node.right_node_idx);
+    }
+
+    // Makes the left child of the node the new root of its subtree, returning the new root.
+    int32_t impl_rotate_right(int32_t node_idx) {
+        int32_t new_root_idx                      = this->memory[node_idx].left_node_idx;
+        this->memory[node_idx].left_node_idx      = this->memory[new_root_idx].right_node_idx;
+        this->memory[new_root_idx].right_node_idx = node_idx;
+
+        this->impl_update_node(node_idx);
+        this->impl_update_node(new_root_idx);
+        return new_root_idx;
+    }
+
+    // Makes the right child of the node the new root of its subtree, returning the new root.
+    int32_t impl_rotate_left(int32_t node_idx) {
+        int32_t new_root_idx                     = this->memory[node_idx].right_node_idx;
+        this->memory[node_idx].right_node_idx    = this->memory[new_root_idx].left_node_idx;
+        this->memory[new_root_idx].left_node_idx = node_idx;
+
+        this->impl_update_node(node_idx);
+        this->impl_update_node(new_root_idx);
+        return new_root_idx;
+    }
+
+    // Restores the AVL invariant of a node whose subtrees are balanced and differ in height by at
+    // most two, returning the new root of the subtree.
+    int32_t impl_rebalance(int32_t node_idx) {
+        this->impl_update_node(node_idx);
+
+        int32_t balance = this->impl_balance_factor(node_idx);
+        if (balance > 1) {
+            int32_t left_idx = this->memory[node_idx].left_node_idx;
+            if (this->impl_balance_factor(left_idx) < 0) {
+                this->memory[node_idx].left_node_idx = this->impl_rotate_left(left_idx);
+            }
+            return this->impl_rotate_right(node_idx);
+        }
+        if (balance < -1) {
+            int32_t right_idx = this->memory[node_idx].right_node_idx;
+            if (this->impl_balance_factor(right_idx) > 0) {
+                this->memory[node_idx].right_node_idx = this->impl_rotate_right(right_idx);
+            }
+            return this->impl_rotate_left(node_idx);
+        }
+
+        return node_idx;
+    }
+
+    // Points the parent to the new child instead of the old one, the parent of the root being LEAF_NODE.
+    void impl_replace_child(int32_t parent_node_idx, int32_t old_child_idx, int32_t new_child_idx) {
+        if (parent_node_idx == LEAF_NODE) {
+            this->root_node_idx = new_child_idx;
+        } else if (this->memory[parent_node_idx].left_node_idx == old_child_idx) {
+            this->memory[parent_node_idx].left_node_idx = new_child_idx;
+        } else {
+            this->memory[parent_node_idx].right_node_idx = new_child_idx;
+        }
+    }
+
+    // Rebalances the nodes of a path from the root, bottom-up, after the subtree below its last node
+    // changed. Once the subtree of a node keeps its root and height the nodes above can't become
+    // unbalanced anymore, and only their sizes are updated.
+    void impl_rebalance_path(int32_t const* path, size_t path_length) {
+        while (path_length > 0) {
+            int32_t node_idx   = path[--path_length];
+            int32_t old_height = this->memory[node_idx].height;
+
+            int32_t new_subtree_root_idx = this->impl_rebalance(node_idx);
+            if (new_subtree_root_idx != node_idx) {
+                int32_t parent_node_idx = (path_length > 0) ? path[path_length - 1] : LEAF_NODE;
+                this->impl_replace_child(parent_node_idx, node_idx, new_subtree_root_idx);
+            } else if (this->memory[node_idx].height == old_height) {
+                break;
             }
         }
 
-        if (next_child_idx != INVALID_NODE_INDEX) {
-            // Continue the search.
-            this->impl_traverse_to_node_index(result, value, next_child_idx);
+        while (path_length > 0) {
+            Node& node        = this->memory[path[--path_length]];
+            node.subtree_size = 1 + this->impl_subtree_size(node.left_node_idx) + this->impl_subtree_size(node.right_node_idx);
         }
     }
 };
@@ -8,13 +8,54 @@
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <new>
 #include <vector>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
 #define max_value(lhs, rhs) (((lhs) >= (rhs)) ? (lhs) : (rhs))
 #define min_value(lhs, rhs) (((lhs) <= (rhs)) ? (lhs) : (rhs))
 
 #define count_of(array) (sizeof(array) / sizeof(*array))
 
+// Hints the CPU to bring the cache line holding the address into all cache levels for reading. The
+// address doesn't need to be valid, invalid addresses are simply ignored.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define prefetch_read(address) _mm_prefetch(reinterpret_cast<char const*>(address), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define prefetch_read(address) __builtin_prefetch((address), 0, 3)
+#else
+#define prefetch_read(address) ((void)(address))
+#endif
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Allocator whose allocations start at a cache line boundary.
+template <typename T>
+struct CacheLineAllocator {
+    using value_type = T;
+
+    CacheLineAllocator() = default;
+
+    template <typename U>
+    constexpr CacheLineAllocator(CacheLineAllocator<U> const&) noexcept {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{CACHE_LINE_SIZE}));
+    }
+
+    void deallocate(T* ptr, size_t) noexcept {
+        ::operator delete(ptr, std::align_val_t{CACHE_LINE_SIZE});
+    }
+
+    template <typename U>
+    bool operator==(CacheLineAllocator<U> const&) const noexcept {
+        return true;
+    }
+};
+
 #define assert_eq(lhs, rhs)                                                                            \
     do {                                                                                               \
         auto                 lhs_value_ = (lhs);                                                       \
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "common.hpp"
+
+// AVL tree shared by many reader threads and a few writer threads, where readers never lock.
+//
+// Every node has a version counter that writers make odd while they modify the node and even again
+// once done, like a seqlock. A reader going down the tree notes the version of a node before reading
+// its fields and checks it didn't change afterwards, and only then trusts the child it read. The
+// version of the parent is also checked once the version of the child is noted, which proves the
+// child was still linked to its parent at that point. Any conflicting write thus makes the reader
+// restart from the root, and readers never write to shared memory so they don't contend for cache
+// lines with each other.
+//
+// Writers are ordered by a mutex and lock, by making their version odd, the nodes they modify for
+// the duration of an insertion or deletion, so readers only wait on or retry the few nodes that are
+// actually changing, which are usually near the leaves.
+//
+// Nodes live in chunks that are never freed before the tree, and slots of deleted nodes are reused
+// without resetting their version, so a reader holding the index of a deleted node always reads
+// valid memory and always notices that the node changed.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+struct ConcurrentBinaryTree {
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+    struct Node {
+        std::atomic<uint64_t> version        = 0;
+        std::atomic<int32_t>  left_node_idx  = LEAF_NODE;
+        std::atomic<int32_t>  right_node_idx = LEAF_NODE;
+        std::atomic<T>        value          = T{};
+        // Only accessed by writers.
+        int32_t height = 1;
+    };
+
+    static constexpr int32_t LEAF_NODE = -1;
+
+    // The right child of the head node is the root of the tree, so that the root is versioned like
+    // any other link.
+    static constexpr int32_t HEAD_NODE = 0;
+
+    static constexpr size_t NODES_PER_CHUNK_LOG2 = 14;
+    static constexpr size_t NODES_PER_CHUNK      = size_t{1} << NODES_PER_CHUNK_LOG2;
+    static constexpr size_t MAX_CHUNK_COUNT      = (size_t{1} << 31) / NODES_PER_CHUNK;
+
+    static constexpr size_t MAX_PATH_LENGTH = 64;
+
+    // Nodes locked by one insertion or deletion: those of its path, and two more per rotation.
+    static constexpr size_t MAX_LOCKED_NODE_COUNT = 4 * MAX_PATH_LENGTH;
+
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    std::unique_ptr<std::atomic<Node*>[]> chunks;
+
+    std::atomic<size_t> node_count = 0;
+
+    // Everything below is only accessed by writers, with the writer mutex held.
+    std::mutex writer_mutex;
+
+    size_t               allocated_node_count = 0;
+    std::vector<int32_t> free_node_indices;
+
+    int32_t locked_nodes[MAX_LOCKED_NODE_COUNT];
+    size_t  locked_node_count = 0;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    ConcurrentBinaryTree() : chunks{new std::atomic<Node*>[MAX_CHUNK_COUNT]} {
+        for (size_t chunk_idx = 0; chunk_idx < MAX_CHUNK_COUNT; ++chunk_idx) {
+            this->chunks[chunk_idx].store(nullptr, std::memory_order_relaxed);
+        }
+
+        int32_t head_node_idx = this->impl_new_node_slot();
+        assert(head_node_idx == HEAD_NODE);
+    }
+
+    ~ConcurrentBinaryTree() {
+        for (size_t chunk_idx = 0; chunk_idx < MAX_CHUNK_COUNT; ++chunk_idx) {
+            delete[] this->chunks[chunk_idx].load(std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentBinaryTree(ConcurrentBinaryTree const&)            = delete;
+    ConcurrentBinaryTree& operator=(ConcurrentBinaryTree const&) = delete;
+
+    size_t size() const {
+        return this->node_count.load(std::memory_order_relaxed);
+    }
+
+    // Lock-free for readers, may be called concurrently with anything.
+    bool contains(T const& value) const {
+        while (true) {
+            int32_t  parent_node_idx = HEAD_NODE;
+            uint64_t parent_version  = this->impl_read_version(HEAD_NODE);
+            int32_t  node_idx        = this->impl_node(HEAD_NODE).right_node_idx.load(std::memory_order_relaxed);
+            if (!this->impl_validate(HEAD_NODE, parent_version)) {
+                continue;
+            }
+
+            bool restart = false;
+            while (node_idx >= 0) {
+                uint64_t node_version = this->impl_read_version(node_idx);
+                if (!this->impl_validate(parent_node_idx, parent_version)) {
+                    restart = true;
+                    break;
+                }
+
+                Node const& node       = this->impl_node(node_idx);
+                T           node_value = node.value.load(std::memory_order_relaxed);
+                int32_t     next_idx   = LEAF_NODE;
+                bool        found      = !(value < node_value) && !(node_value < value);
+                if (!found) {
+                    next_idx = (value < node_value) ? node.left_node_idx.load(std::memory_order_relaxed)
+                                                    : node.right_node_idx.load(std::memory_order_relaxed);
+                }
+
+                if (!this->impl_validate(node_idx, node_version)) {
+                    restart = true;
+                    break;
+                }
+                if (found) {
+                    return true;
+                }
+
+                parent_node_idx = node_idx;
+                parent_version  = node_version;
+                node_idx        = next_idx;
+            }
+
+            // The last link read was a leaf, and was validated with its node.
+            if (!restart) {
+                return false;
+            }
+        }
+    }
+
+    // Returns whether the value wasn't in the tree already.
+    bool insert_node(T const& value) {
+        std::lock_guard<std::mutex> writer_lock{this->writer_mutex};
+
+        int32_t path[MAX_PATH_LENGTH];
+        size_t  path_length = 0;
+
+        int32_t current_node_idx = this->impl_child(HEAD_NODE, false);
+        while (current_node_idx >= 0) {
+            T current_value = this->impl_value(current_node_idx);
+            if (value < current_value) {
+                path[path_length++] = current_node_idx;
+                current_node_idx    = this->impl_child(current_node_idx, true);
+            } else if (current_value < value) {
+                path[path_length++] = current_node_idx;
+                current_node_idx    = this->impl_child(current_node_idx, false);
+            } else {
+                return false;
+            }
+        }
+
+        int32_t new_node_idx = this->impl_allocate_node(value);
+        if (path_length == 0) {
+            this->impl_set_child(HEAD_NODE, false, new_node_idx);
+        } else {
+            int32_t parent_node_idx = path[path_length - 1];
+            this->impl_set_child(parent_node_idx, value < this->impl_value(parent_node_idx), new_node_idx);
+        }
+
+        this->impl_rebalance_path(path, path_length);
+        this->impl_unlock_all();
+        this->node_count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Returns whether the value was in the tree.
+    bool delete_node(T const& value) {
+        std::lock_guard<std::mutex> writer_lock{this->writer_mutex};
+
+        int32_t path[MAX_PATH_LENGTH];
+        size_t  path_length = 0;
+
+        int32_t deleted_node_idx = this->impl_child(HEAD_NODE, false);
+        while (deleted_node_idx >= 0) {
+            T current_value = this->impl_value(deleted_node_idx);
+            if (value < current_value) {
+                path[path_length++] = deleted_node_idx;
+                deleted_node_idx    = this->impl_child(deleted_node_idx, true);
+            } else if (current_value < value) {
+                path[path_length++] = deleted_node_idx;
+                deleted_node_idx    = this->impl_child(deleted_node_idx, false);
+            } else {
+                break;
+            }
+        }
+
+        if (deleted_node_idx < 0) {
+            return false;
+        }
+
+        int32_t parent_node_idx = (path_length > 0) ? path[path_length - 1] : HEAD_NODE;
+        int32_t left_idx        = this->impl_child(deleted_node_idx, true);
+        int32_t right_idx       = this->impl_child(deleted_node_idx, false);
+
+        int32_t replacement_node_idx;
+        if (left_idx == LEAF_NODE) {
+            replacement_node_idx = right_idx;
+        } else if (right_idx == LEAF_NODE) {
+            replacement_node_idx = left_idx;
+        } else {
+            // Relink the successor in place of the deleted node, as in BinaryTree. Every node from
+            // the deleted one down to the successor gets locked, so readers looking for the value of
+            // the successor can't miss it while it moves up.
+            size_t deleted_path_idx = path_length;
+            path[path_length++]     = deleted_node_idx;
+
+            int32_t successor_idx = right_idx;
+            while (this->impl_child(successor_idx, true) >= 0) {
+                path[path_length++] = successor_idx;
+                successor_idx       = this->impl_child(successor_idx, true);
+            }
+
+            for (size_t path_idx = deleted_path_idx; path_idx < path_length; ++path_idx) {
+                this->impl_lock(path[path_idx]);
+            }
+
+            this->impl_replace_child(path[path_length - 1], successor_idx, this->impl_child(successor_idx, false));
+            this->impl_set_child(successor_idx, true, this->impl_child(deleted_node_idx, true));
+            this->impl_set_child(successor_idx, false, this->impl_child(deleted_node_idx, false));
+            this->impl_node(successor_idx).height = this->impl_node(deleted_node_idx).height;
+
+            path[deleted_path_idx] = successor_idx;
+            replacement_node_idx   = successor_idx;
+        }
+
+        this->impl_lock(deleted_node_idx);
+        this->impl_replace_child(parent_node_idx, deleted_node_idx, replacement_node_idx);
+        this->impl_rebalance_path(path, path_length);
+        this->impl_unlock_all();
+
+        this->free_node_indices.push_back(deleted_node_idx);
+        this->node_count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------
+    // Implementation details.
+    // -----------------------------------------------------------------------------
+
+    Node& impl_node(int32_t node_idx) const {
+        size_t chunk_idx = static_cast<size_t>(node_idx) >> NODES_PER_CHUNK_LOG2;
+        size_t slot_idx  = static_cast<size_t>(node_idx) & (NODES_PER_CHUNK - 1);
+        return this->chunks[chunk_idx].load(std::memory_order_acquire)[slot_idx];
+    }
+
+    // Waits until no writer holds the node, returning its version.
+    uint64_t impl_read_version(int32_t node_idx) const {
+        std::atomic<uint64_t> const& version = this->impl_node(node_idx).version;
+
+        uint64_t node_version = version.load(std::memory_order_acquire);
+        while (node_version & 1) {
+            std::this_thread::yield();
+            node_version = version.load(std::memory_order_acquire);
+        }
+        return node_version;
+    }
+
+    // Tells whether the fields read from the node since its version was read are consistent.
+    bool impl_validate(int32_t node_idx, uint64_t node_version) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return this->impl_node(node_idx).version.load(std::memory_order_relaxed) == node_version;
+    }
+
+    // Writers see their own changes, so they read fields without versions.
+    int32_t impl_child(int32_t node_idx, bool is_left) const {
+        Node const& node = this->impl_node(node_idx);
+        return (is_left ? node.left_node_idx : node.right_node_idx).load(std::memory_order_relaxed);
+    }
+
+    T impl_value(int32_t node_idx) const {
+        return this->impl_node(node_idx).value.load(std::memory_order_relaxed);
+    }
+
+    int32_t impl_height(int32_t node_idx) const {
+        return (node_idx >= 0) ? this->impl_node(node_idx).height : 0;
+    }
+
+    // Makes the version of the node odd, unless the current writer did already.
+    void impl_lock(int32_t node_idx) {
+        std::atomic<uint64_t>& version      = this->impl_node(node_idx).version;
+        uint64_t               node_version = version.load(std::memory_order_relaxed);
+        if (node_version & 1) {
+            return;
+        }
+
+        assert(this->locked_node_count < MAX_LOCKED_NODE_COUNT);
+        this->locked_nodes[this->locked_node_count++] = node_idx;
+        version.store(node_version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void impl_unlock_all() {
+        for (size_t locked_idx = 0; locked_idx < this->locked_node_count; ++locked_idx) {
+            std::atomic<uint64_t>& version = this->impl_node(this->locked_nodes[locked_idx]).version;
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        this->locked_node_count = 0;
+    }
+
+    void impl_set_child(int32_t node_idx, bool is_left, int32_t child_idx) {
+        this->impl_lock(node_idx);
+        Node& node = this->impl_node(node_idx);
+        (is_left ? node.left_node_idx : node.right_node_idx).store(child_idx, std::memory_order_relaxed);
+    }
+
+    void impl_replace_child(int32_t parent_node_idx, int32_t old_child_idx, int32_t new_child_idx) {
+        bool is_left = (parent_node_idx != HEAD_NODE) && (this->impl_child(parent_node_idx, true) == old_child_idx);
+        this->impl_set_child(parent_node_idx, is_left, new_child_idx);
+    }
+
+    // Takes a slot that no reader can reach, from a new chunk if needed.
+    int32_t impl_new_node_slot() {
+        if (!this->free_node_indices.empty()) {
+            int32_t node_idx = this->free_node_indices.back();
+            this->free_node_indices.pop_back();
+            return node_idx;
+        }
+
+        size_t node_idx  = this->allocated_node_count++;
+        size_t chunk_idx = node_idx >> NODES_PER_CHUNK_LOG2;
+        assert(chunk_idx < MAX_CHUNK_COUNT);
+        if (this->chunks[chunk_idx].load(std::memory_order_relaxed) == nullptr) {
+            this->chunks[chunk_idx].store(new Node[NODES_PER_CHUNK], std::memory_order_release);
+        }
+        return static_cast<int32_t>(node_idx);
+    }
+
+    int32_t impl_allocate_node(T const& value) {
+        int32_t node_idx = this->impl_new_node_slot();
+
+        // Readers still holding the index of a previous node in the slot must see it change.
+        this->impl_lock(node_idx);
+        Node& node = this->impl_node(node_idx);
+        node.left_node_idx.store(LEAF_NODE, std::memory_order_relaxed);
+        node.right_node_idx.store(LEAF_NODE, std::memory_order_relaxed);
+        node.value.store(value, std::memory_order_relaxed);
+        node.height = 1;
+        return node_idx;
+    }
+
+    void impl_update_height(int32_t node_idx) {
+        Node& node  = this->impl_node(node_idx);
+        node.height = 1 + std::max(this->impl_height(this->impl_child(node_idx, true)), this->impl_height(this->impl_child(node_idx, false)));
+    }
+
+    int32_t impl_balance_factor(int32_t node_idx) const {
+        return this->impl_height(this->impl_child(node_idx, true)) - this->impl_height(this->impl_child(node_idx, false));
+    }
+
+    // Rotates the child on the given side of the node up, returning the new root of the subtree.
+    int32_t impl_rotate(int32_t node_idx, bool left_child_up) {
+        int32_t new_root_idx = this->impl_child(node_idx, left_child_up);
+        this->impl_set_child(node_idx, left_child_up, this->impl_child(new_root_idx, !left_child_up));
+        this->impl_set_child(new_root_idx, !left_child_up, node_idx);
+
+        this->impl_update_height(node_idx);
+        this->impl_update_height(new_root_idx);
+        return new_root_idx;
+    }
+
+    int32_t impl_rebalance(int32_t node_idx) {
+        this->impl_update_height(node_idx);
+
+        int32_t balance = this->impl_balance_factor(node_idx);
+        if (balance > 1) {
+            int32_t left_idx = this->impl_child(node_idx, true);
+            if (this->impl_balance_factor(left_idx) < 0) {
+                this->impl_set_child(node_idx, true, this->impl_rotate(left_idx, false));
+            }
+            return this->impl_rotate(node_idx, true);
+        }
+        if (balance < -1) {
+            int32_t right_idx = this->impl_child(node_idx, false);
+            if (this->impl_balance_factor(right_idx) > 0) {
+                this->impl_set_child(node_idx, false, this->impl_rotate(right_idx, true));
+            }
+            return this->impl_rotate(node_idx, false);
+        }
+
+        return node_idx;
+    }
+
+    // Same as BinaryTree::impl_rebalance_path, where the parent of the root is the head node.
+    void impl_rebalance_path(int32_t const* path, size_t path_length) {
+        while (path_length > 0) {
+            int32_t node_idx   = path[--path_length];
+            int32_t old_height = this->impl_node(node_idx).height;
+
+            int32_t new_subtree_root_idx = this->impl_rebalance(node_idx);
+            if (new_subtree_root_idx != node_idx) {
+                int32_t parent_node_idx = (path_length > 0) ? path[path_length - 1] : HEAD_NODE;
+                this->impl_replace_child(parent_node_idx, node_idx, new_subtree_root_idx);
+            } else if (this->impl_node(node_idx).height == old_height) {
+                break;
+            }
+        }
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "binary_tree.hpp"
+#include "common.hpp"
+
+// Immutable search index over a set of keys, stored in the BFS order of a complete binary tree
+// (Eytzinger layout): the children of the key at slot k are at slots 2k and 2k + 1, and the first
+// slot is left empty.
+//
+// The first levels of the tree share a handful of cache lines that stay hot, and the descent does a
+// single comparison per level without branching on it. The descendants of a key a few levels down
+// are contiguous and fill a cache line, which is prefetched while the levels in between are compared,
+// so the cache misses of large indices overlap instead of being paid one after the other as in a
+// binary search.
+template <typename T>
+struct EytzingerIndex {
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+
+    // How many keys fit a cache line, the descendants of a key log2(KEYS_PER_CACHE_LINE) levels down
+    // fill exactly one.
+    static constexpr size_t KEYS_PER_CACHE_LINE = max_value(CACHE_LINE_SIZE / sizeof(T), size_t{1});
+
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    // Slot 0 is unused, so that the slots of the descendants of a key line up with cache lines.
+    std::vector<T, CacheLineAllocator<T>> keys;
+
+    size_t key_count = 0;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    EytzingerIndex()  = delete;
+    ~EytzingerIndex() = default;
+
+    // The keys must be sorted in ascending order.
+    explicit EytzingerIndex(std::vector<T> const& sorted_keys) {
+        assert(std::is_sorted(sorted_keys.begin(), sorted_keys.end()));
+        this->impl_build(sorted_keys);
+    }
+
+    template <typename V>
+    explicit EytzingerIndex(BinaryTree<T, V> const& tree) {
+        std::vector<T> sorted_keys(tree.begin(), tree.end());
+        this->impl_build(sorted_keys);
+    }
+
+    size_t size() const {
+        return this->key_count;
+    }
+
+    // Returns the smallest key not less than the value, or nullptr if there's none.
+    T const* lower_bound(T value) const {
+        size_t slot = this->impl_lower_bound_slot(value);
+        return (slot != 0) ? &this->keys[slot] : nullptr;
+    }
+
+    bool contains(T value) const {
+        size_t slot = this->impl_lower_bound_slot(value);
+        return (slot != 0) && !(value < this->keys[slot]);
+    }
+
+    // -----------------------------------------------------------------------------
+    // Implementation details.
+    // -----------------------------------------------------------------------------
+
+    void impl_build(std::vector<T> const& sorted_keys) {
+        this->key_count = sorted_keys.size();
+        this->keys.resize(this->key_count + 1);
+
+        size_t sorted_idx = 0;
+        this->impl_fill(sorted_keys, sorted_idx, 1);
+    }
+
+    // An in-order walk of the implicit tree visits the slots in the order of the sorted keys.
+    void impl_fill(std::vector<T> const& sorted_keys, size_t& sorted_idx, size_t slot) {
+        if (slot > this->key_count) {
+            return;
+        }
+
+        this->impl_fill(sorted_keys, sorted_idx, 2 * slot);
+        this->keys[slot] = sorted_keys[sorted_idx++];
+        this->impl_fill(sorted_keys, sorted_idx, 2 * slot + 1);
+    }
+
+    // Returns the slot of the smallest key not less than the value, or 0 if there's none.
+    size_t impl_lower_bound_slot(T value) const {
+        T const* slots = this->keys.data();
+
+        size_t slot = 1;
+        while (slot <= this->key_count) {
+            // The address may lie past the end of the keys, in which case the prefetch does nothing.
+            uintptr_t descendants_address = reinterpret_cast<uintptr_t>(slots) + slot * KEYS_PER_CACHE_LINE * sizeof(T);
+            prefetch_read(reinterpret_cast<void const*>(descendants_address));
+            slot = 2 * slot + static_cast<size_t>(slots[slot] < value);
+        }
+
+        // The path went right while the keys were smaller than the value, and left at the answer:
+        // drop the trailing right turns, then the left turn itself.
+        slot >>= std::countr_one(slot) + 1;
+        return slot;
+    }
+};
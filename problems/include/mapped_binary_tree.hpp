@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include "binary_tree.hpp"
+#include "common.hpp"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only mapping of a whole file into memory.
+struct MappedFile {
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    uint8_t const* data = nullptr;
+    size_t         size = 0;
+
+#if defined(_WIN32)
+    HANDLE file_handle    = INVALID_HANDLE_VALUE;
+    HANDLE mapping_handle = nullptr;
+#else
+    int file_descriptor = -1;
+#endif
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    MappedFile() = default;
+
+    ~MappedFile() {
+        this->close();
+    }
+
+    MappedFile(MappedFile const&)            = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    // Returns whether the file could be mapped. Empty files can't.
+    bool open(char const* path) {
+        this->close();
+
+#if defined(_WIN32)
+        this->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER file_size;
+        if (this->file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(this->file_handle, &file_size) || file_size.QuadPart == 0) {
+            this->close();
+            return false;
+        }
+
+        this->mapping_handle = CreateFileMappingA(this->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void const* view     = (this->mapping_handle != nullptr) ? MapViewOfFile(this->mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view == nullptr) {
+            this->close();
+            return false;
+        }
+
+        this->data = static_cast<uint8_t const*>(view);
+        this->size = static_cast<size_t>(file_size.QuadPart);
+#else
+        this->file_descriptor = ::open(path, O_RDONLY);
+        struct stat file_stat;
+        if (this->file_descriptor < 0 || fstat(this->file_descriptor, &file_stat) != 0 || file_stat.st_size == 0) {
+            this->close();
+            return false;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, this->file_descriptor, 0);
+        if (view == MAP_FAILED) {
+            this->close();
+            return false;
+        }
+
+        this->data = static_cast<uint8_t const*>(view);
+        this->size = static_cast<size_t>(file_stat.st_size);
+#endif
+        return true;
+    }
+
+    void close() {
+#if defined(_WIN32)
+        if (this->data != nullptr) {
+            UnmapViewOfFile(this->data);
+        }
+        if (this->mapping_handle != nullptr) {
+            CloseHandle(this->mapping_handle);
+        }
+        if (this->file_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(this->file_handle);
+        }
+        this->mapping_handle = nullptr;
+        this->file_handle    = INVALID_HANDLE_VALUE;
+#else
+        if (this->data != nullptr) {
+            munmap(const_cast<uint8_t*>(this->data), this->size);
+        }
+        if (this->file_descriptor >= 0) {
+            ::close(this->file_descriptor);
+        }
+        this->file_descriptor = -1;
+#endif
+        this->data = nullptr;
+        this->size = 0;
+    }
+};
+
+// BinaryTree saved to a file and queried in place from a read-only mapping of it, so that loading a
+// tree costs no more than paging in the parts of it that are looked at.
+//
+// The file holds a header followed by an exact copy of the memory of the tree, and then of its
+// values if it has any, each starting at a cache line boundary. Nodes link to each other by index,
+// so they're valid wherever the file is mapped. Free slots are saved along with the live nodes, so
+// that saving is a plain write of both arrays.
+//
+// The header records the layout of the nodes and the byte order, which the view checks when opening
+// a file. The comparator isn't recorded and must order the keys as the one of the saved tree did.
+template <typename K, typename V = NoValue, typename Compare = std::less<K>>
+    requires std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>
+struct MappedBinaryTree {
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+
+    using Tree = BinaryTree<K, V, Compare>;
+    using Node = typename Tree::Node;
+
+    static constexpr char MAGIC[8] = {'B', 'I', 'N', 'T', 'R', 'E', 'E', '\0'};
+
+    // Bump whenever the layout of the file or of the nodes changes.
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    // Reads differently on machines of the other byte order.
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct FileHeader {
+        char     magic[8];
+        uint32_t format_version;
+        uint32_t byte_order_mark;
+        uint32_t node_size;
+        uint32_t key_size;
+        uint32_t value_size;
+        int32_t  root_node_idx;
+        uint64_t node_count;
+        uint64_t slot_count;
+        // Offsets from the start of the file, the values one being zero for trees without values.
+        uint64_t nodes_offset;
+        uint64_t values_offset;
+    };
+
+    static constexpr uint64_t align_to_cache_line(uint64_t offset) {
+        return (offset + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    }
+
+    // Returns whether the whole tree could be written to the file, which is replaced if it exists.
+    static bool save(Tree const& tree, char const* path) {
+        FileHeader header = {};
+
+        header.format_version  = FORMAT_VERSION;
+        header.byte_order_mark = BYTE_ORDER_MARK;
+        header.node_size       = static_cast<uint32_t>(sizeof(Node));
+        header.key_size        = static_cast<uint32_t>(sizeof(K));
+        header.value_size      = Tree::HAS_VALUES ? static_cast<uint32_t>(sizeof(V)) : 0;
+        header.root_node_idx   = tree.root_node_idx;
+        header.node_count      = tree.size();
+        header.slot_count      = tree.memory.size();
+        header.nodes_offset    = align_to_cache_line(sizeof(FileHeader));
+        header.values_offset   = Tree::HAS_VALUES ? align_to_cache_line(header.nodes_offset + header.slot_count * sizeof(Node)) : 0;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        char const    padding[CACHE_LINE_SIZE] = {};
+
+        file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        file.write(padding, static_cast<std::streamsize>(header.nodes_offset - sizeof(header)));
+        file.write(reinterpret_cast<char const*>(tree.memory.data()), static_cast<std::streamsize>(header.slot_count * sizeof(Node)));
+        if constexpr (Tree::HAS_VALUES) {
+            uint64_t nodes_end = header.nodes_offset + header.slot_count * sizeof(Node);
+            file.write(padding, static_cast<std::streamsize>(header.values_offset - nodes_end));
+            file.write(reinterpret_cast<char const*>(tree.values.data()), static_cast<std::streamsize>(header.slot_count * sizeof(V)));
+        }
+
+        file.close();
+        return !file.fail();
+    }
+
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    MappedFile file;
+
+    Node const* memory        = nullptr;
+    V const*    values        = nullptr;
+    int32_t     root_node_idx = Tree::LEAF_NODE;
+    size_t      node_count    = 0;
+
+    Compare compare;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    MappedBinaryTree()  = default;
+    ~MappedBinaryTree() = default;
+
+    MappedBinaryTree(MappedBinaryTree const&)            = delete;
+    MappedBinaryTree& operator=(MappedBinaryTree const&) = delete;
+
+    // Maps the tree saved at the path, returning false if the file can't be mapped or doesn't hold a
+    // tree of this type. The links between the nodes aren't checked.
+    bool open(char const* path) {
+        this->memory        = nullptr;
+        this->values        = nullptr;
+        this->root_node_idx = Tree::LEAF_NODE;
+        this->node_count    = 0;
+        if (!this->file.open(path) || this->file.size < sizeof(FileHeader)) {
+            return false;
+        }
+
+        FileHeader header;
+        std::memcpy(&header, this->file.data, sizeof(header));
+
+        // Bounded by dividing the room left after the offsets, since a corrupt slot count could make
+        // the end of the arrays wrap around.
+        uint64_t file_size  = this->file.size;
+        bool     nodes_fit  = header.nodes_offset <= file_size && header.slot_count <= (file_size - header.nodes_offset) / sizeof(Node);
+        bool     values_fit = header.values_offset <= file_size && header.slot_count <= (file_size - header.values_offset) / sizeof(V);
+        bool     is_valid   = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                        && header.format_version == FORMAT_VERSION
+                        && header.byte_order_mark == BYTE_ORDER_MARK
+                        && header.node_size == sizeof(Node)
+                        && header.key_size == sizeof(K)
+                        && header.value_size == (Tree::HAS_VALUES ? sizeof(V) : 0)
+                        && header.node_count <= header.slot_count
+                        && header.root_node_idx < static_cast<int64_t>(header.slot_count)
+                        && (header.root_node_idx >= 0 || header.node_count == 0)
+                        && header.nodes_offset % CACHE_LINE_SIZE == 0
+                        && nodes_fit
+                        && (!Tree::HAS_VALUES || (header.values_offset % CACHE_LINE_SIZE == 0 && values_fit));
+        if (!is_valid) {
+            this->file.close();
+            return false;
+        }
+
+        this->memory        = reinterpret_cast<Node const*>(this->file.data + header.nodes_offset);
+        this->values        = Tree::HAS_VALUES ? reinterpret_cast<V const*>(this->file.data + header.values_offset) : nullptr;
+        this->root_node_idx = header.root_node_idx;
+        this->node_count    = static_cast<size_t>(header.node_count);
+        return true;
+    }
+
+    size_t size() const {
+        return this->node_count;
+    }
+
+    template <typename KeyLike>
+    int32_t find_node(KeyLike const& key) const {
+        typename Tree::template LookupKey<KeyLike> const& lookup_key = key;
+
+        int32_t current_node_idx = this->root_node_idx;
+        while (current_node_idx >= 0) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(lookup_key, current_node.key)) {
+                current_node_idx = current_node.left_node_idx;
+            } else if (this->compare(current_node.key, lookup_key)) {
+                current_node_idx = current_node.right_node_idx;
+            } else {
+                return current_node_idx;
+            }
+        }
+        return Tree::INVALID_NODE_INDEX;
+    }
+
+    template <typename KeyLike>
+    bool contains(KeyLike const& key) const {
+        return this->find_node(key) >= 0;
+    }
+
+    // Returns the value of the key, or nullptr if it isn't in the tree.
+    template <typename KeyLike>
+    V const* find_value(KeyLike const& key) const
+        requires Tree::HAS_VALUES
+    {
+        int32_t node_idx = this->find_node(key);
+        return (node_idx >= 0) ? &this->values[node_idx] : nullptr;
+    }
+
+    // Returns the smallest key not less than the given one, or nullptr if there's none.
+    template <typename KeyLike>
+    K const* lower_bound(KeyLike const& key) const {
+        typename Tree::template LookupKey<KeyLike> const& lookup_key = key;
+
+        K const* found_key        = nullptr;
+        int32_t  current_node_idx = this->root_node_idx;
+        while (current_node_idx >= 0) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(current_node.key, lookup_key)) {
+                current_node_idx = current_node.right_node_idx;
+            } else {
+                found_key        = &current_node.key;
+                current_node_idx = current_node.left_node_idx;
+            }
+        }
+        return found_key;
+    }
+
+    // Returns the count of keys less than the given one.
+    template <typename KeyLike>
+    size_t rank(KeyLike const& key) const {
+        typename Tree::template LookupKey<KeyLike> const& lookup_key = key;
+
+        size_t  less_count       = 0;
+        int32_t current_node_idx = this->root_node_idx;
+        while (current_node_idx >= 0) {
+            Node const& current_node = this->memory[current_node_idx];
+            if (this->compare(current_node.key, lookup_key)) {
+                int32_t left_node_idx = current_node.left_node_idx;
+                less_count           += static_cast<size_t>((left_node_idx >= 0) ? this->memory[left_node_idx].subtree_size : 0) + 1;
+                current_node_idx      = current_node.right_node_idx;
+            } else {
+                current_node_idx = current_node.left_node_idx;
+            }
+        }
+        return less_count;
+    }
+};
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "common.hpp"
+
+// Persistent AVL tree: insertions and deletions never modify nodes, they copy the O(log n) nodes of
+// the path to the change instead and make a new version of the tree out of the new path and the
+// untouched subtrees of the previous version. Snapshots of any version can thus be read from any
+// thread without locks while updates go on, and stay consistent.
+//
+// Nodes are bump allocated from blocks. The nodes an update replaces are retired with the version
+// it creates, and reclaimed once no snapshot older than that version is alive anymore: a block is
+// freed as a whole as soon as none of its nodes is alive, so nodes are never freed one by one.
+template <typename T>
+struct PersistentBinaryTree {
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+    struct Node {
+        Node const* left_node  = nullptr;
+        Node const* right_node = nullptr;
+        int32_t     height     = 1;
+        // Index of the block holding the node.
+        uint32_t    block_idx  = 0;
+        T           value      = T{};
+    };
+
+    struct Block {
+        std::unique_ptr<Node[]> nodes;
+        size_t                  used_count = 0;
+        // Nodes allocated from the block that haven't been reclaimed yet.
+        size_t                  live_count = 0;
+    };
+
+    // Nodes no longer part of the versions starting at the given one.
+    struct RetireList {
+        uint64_t                 version;
+        std::vector<Node const*> nodes;
+    };
+
+    // Immutable view of a version of the tree, readable from any thread until it's released.
+    struct Snapshot {
+        Node const* root_node  = nullptr;
+        uint64_t    version    = 0;
+        size_t      node_count = 0;
+
+        size_t size() const {
+            return this->node_count;
+        }
+
+        bool contains(T const& value) const {
+            Node const* current_node = this->root_node;
+            while (current_node != nullptr) {
+                if (value < current_node->value) {
+                    current_node = current_node->left_node;
+                } else if (current_node->value < value) {
+                    current_node = current_node->right_node;
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Calls the visitor with each value, in ascending order.
+        template <typename Visitor>
+        void for_each(Visitor&& visitor) const {
+            Node const* stack[MAX_PATH_LENGTH];
+            size_t      stack_length = 0;
+
+            Node const* current_node = this->root_node;
+            while (current_node != nullptr || stack_length > 0) {
+                while (current_node != nullptr) {
+                    stack[stack_length++] = current_node;
+                    current_node          = current_node->left_node;
+                }
+
+                current_node = stack[--stack_length];
+                visitor(current_node->value);
+                current_node = current_node->right_node;
+            }
+        }
+    };
+
+    static constexpr size_t NODES_PER_BLOCK = 4096;
+
+    static constexpr size_t MAX_PATH_LENGTH = 64;
+
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    // Guards everything below. Reading the nodes of a snapshot doesn't need it.
+    mutable std::mutex mutex;
+
+    Node const* root_node  = nullptr;
+    uint64_t    version    = 0;
+    size_t      node_count = 0;
+
+    // Freed blocks leave a null slot, reused by the next block.
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::vector<uint32_t>               free_block_indices;
+    uint32_t                            current_block_idx = 0;
+
+    // Count of live snapshots of each version.
+    std::map<uint64_t, size_t> snapshot_counts;
+
+    // Sorted by version.
+    std::deque<RetireList> retire_lists;
+
+    // Nodes replaced by the update in progress.
+    std::vector<Node const*> retired_nodes;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    PersistentBinaryTree() {
+        this->impl_start_block();
+    }
+
+    ~PersistentBinaryTree() = default;
+
+    PersistentBinaryTree(PersistentBinaryTree const&)            = delete;
+    PersistentBinaryTree& operator=(PersistentBinaryTree const&) = delete;
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock{this->mutex};
+        return this->node_count;
+    }
+
+    size_t block_count() const {
+        std::lock_guard<std::mutex> lock{this->mutex};
+        return this->blocks.size() - this->free_block_indices.size();
+    }
+
+    // The nodes of the snapshot stay alive until it's released.
+    Snapshot acquire_snapshot() {
+        std::lock_guard<std::mutex> lock{this->mutex};
+        this->snapshot_counts[this->version] += 1;
+        return Snapshot{.root_node = this->root_node, .version = this->version, .node_count = this->node_count};
+    }
+
+    void release_snapshot(Snapshot const& snapshot) {
+        std::lock_guard<std::mutex> lock{this->mutex};
+
+        auto snapshot_count = this->snapshot_counts.find(snapshot.version);
+        assert(snapshot_count != this->snapshot_counts.end());
+        if (--snapshot_count->second == 0) {
+            this->snapshot_counts.erase(snapshot_count);
+            this->impl_reclaim();
+        }
+    }
+
+    // Returns whether the value wasn't in the tree already, in which case a new version is made.
+    bool insert_node(T const& value) {
+        std::lock_guard<std::mutex> lock{this->mutex};
+
+        bool        inserted = false;
+        Node const* new_root = this->impl_insert(this->root_node, value, inserted);
+        if (inserted) {
+            this->node_count += 1;
+            this->impl_publish(new_root);
+        }
+        return inserted;
+    }
+
+    // Returns whether the value was in the tree, in which case a new version is made.
+    bool delete_node(T const& value) {
+        std::lock_guard<std::mutex> lock{this->mutex};
+
+        bool        deleted  = false;
+        Node const* new_root = this->impl_delete(this->root_node, value, deleted);
+        if (deleted) {
+            this->node_count -= 1;
+            this->impl_publish(new_root);
+        }
+        return deleted;
+    }
+
+    // -----------------------------------------------------------------------------
+    // Implementation details.
+    // -----------------------------------------------------------------------------
+
+    void impl_start_block() {
+        auto new_block   = std::make_unique<Block>();
+        new_block->nodes = std::make_unique<Node[]>(NODES_PER_BLOCK);
+
+        if (!this->free_block_indices.empty()) {
+            this->current_block_idx = this->free_block_indices.back();
+            this->free_block_indices.pop_back();
+            this->blocks[this->current_block_idx] = std::move(new_block);
+        } else {
+            this->current_block_idx = static_cast<uint32_t>(this->blocks.size());
+            this->blocks.push_back(std::move(new_block));
+        }
+    }
+
+    Node const* impl_make_node(T const& value, Node const* left_node, Node const* right_node) {
+        Block* block = this->blocks[this->current_block_idx].get();
+        if (block->used_count == NODES_PER_BLOCK) {
+            uint32_t full_block_idx = this->current_block_idx;
+            this->impl_start_block();
+            if (block->live_count == 0) {
+                this->impl_free_block(full_block_idx);
+            }
+            block = this->blocks[this->current_block_idx].get();
+        }
+
+        Node& node      = block->nodes[block->used_count++];
+        node.left_node  = left_node;
+        node.right_node = right_node;
+        node.height     = 1 + std::max(impl_height(left_node), impl_height(right_node));
+        node.block_idx  = this->current_block_idx;
+        node.value      = value;
+        block->live_count += 1;
+        return &node;
+    }
+
+    void impl_free_block(uint32_t block_idx) {
+        this->blocks[block_idx].reset();
+        this->free_block_indices.push_back(block_idx);
+    }
+
+    // The node is part of the current version but won't be part of the next one.
+    void impl_retire(Node const* node) {
+        this->retired_nodes.push_back(node);
+    }
+
+    void impl_publish(Node const* new_root) {
+        this->root_node  = new_root;
+        this->version   += 1;
+
+        if (!this->retired_nodes.empty()) {
+            this->retire_lists.push_back(RetireList{.version = this->version, .nodes = std::move(this->retired_nodes)});
+            this->retired_nodes.clear();
+        }
+        this->impl_reclaim();
+    }
+
+    // Reclaims the nodes retired by versions that every live snapshot is at least as recent as.
+    void impl_reclaim() {
+        uint64_t oldest_version = this->snapshot_counts.empty() ? this->version : this->snapshot_counts.begin()->first;
+        while (!this->retire_lists.empty() && this->retire_lists.front().version <= oldest_version) {
+            for (Node const* node : this->retire_lists.front().nodes) {
+                uint32_t block_idx = node->block_idx;
+                Block*   block     = this->blocks[block_idx].get();
+                block->live_count -= 1;
+                if (block->live_count == 0 && block_idx != this->current_block_idx) {
+                    this->impl_free_block(block_idx);
+                }
+            }
+            this->retire_lists.pop_front();
+        }
+    }
+
+    static int32_t impl_height(Node const* node) {
+        return (node != nullptr) ? node->height : 0;
+    }
+
+    // Makes a node out of the value and subtrees, whose heights differ by at most two, rotating it
+    // if needed. The nodes moved by a rotation are copied and retired.
+    Node const* impl_balance(T const& value, Node const* left_node, Node const* right_node) {
+        int32_t left_height  = impl_height(left_node);
+        int32_t right_height = impl_height(right_node);
+
+        if (left_height > right_height + 1) {
+            this->impl_retire(left_node);
+            if (impl_height(left_node->left_node) >= impl_height(left_node->right_node)) {
+                return this->impl_make_node(
+                    left_node->value,
+                    left_node->left_node,
+                    this->impl_make_node(value, left_node->right_node, right_node));
+            }
+
+            Node const* pivot = left_node->right_node;
+            this->impl_retire(pivot);
+            return this->impl_make_node(
+                pivot->value,
+                this->impl_make_node(left_node->value, left_node->left_node, pivot->left_node),
+                this->impl_make_node(value, pivot->right_node, right_node));
+        }
+
+        if (right_height > left_height + 1) {
+            this->impl_retire(right_node);
+            if (impl_height(right_node->right_node) >= impl_height(right_node->left_node)) {
+                return this->impl_make_node(
+                    right_node->value,
+                    this->impl_make_node(value, left_node, right_node->left_node),
+                    right_node->right_node);
+            }
+
+            Node const* pivot = right_node->left_node;
+            this->impl_retire(pivot);
+            return this->impl_make_node(
+                pivot->value,
+                this->impl_make_node(value, left_node, pivot->left_node),
+                this->impl_make_node(right_node->value, pivot->right_node, right_node->right_node));
+        }
+
+        return this->impl_make_node(value, left_node, right_node);
+    }
+
+    // Returns the new root of the subtree, which is the same as before if the value was there.
+    Node const* impl_insert(Node const* node, T const& value, bool& inserted) {
+        if (node == nullptr) {
+            inserted = true;
+            return this->impl_make_node(value, nullptr, nullptr);
+        }
+
+        if (value < node->value) {
+            Node const* new_left_node = this->impl_insert(node->left_node, value, inserted);
+            if (!inserted) {
+                return node;
+            }
+            this->impl_retire(node);
+            return this->impl_balance(node->value, new_left_node, node->right_node);
+        }
+        if (node->value < value) {
+            Node const* new_right_node = this->impl_insert(node->right_node, value, inserted);
+            if (!inserted) {
+                return node;
+            }
+            this->impl_retire(node);
+            return this->impl_balance(node->value, node->left_node, new_right_node);
+        }
+        return node;
+    }
+
+    // Unlinks the minimum of the subtree, returning the new root of the subtree.
+    Node const* impl_delete_min(Node const* node, T& min_value) {
+        this->impl_retire(node);
+        if (node->left_node == nullptr) {
+            min_value = node->value;
+            return node->right_node;
+        }
+
+        Node const* new_left_node = this->impl_delete_min(node->left_node, min_value);
+        return this->impl_balance(node->value, new_left_node, node->right_node);
+    }
+
+    // Returns the new root of the subtree, which is the same as before if the value wasn't there.
+    Node const* impl_delete(Node const* node, T const& value, bool& deleted) {
+        if (node == nullptr) {
+            return nullptr;
+        }
+
+        if (value < node->value) {
+            Node const* new_left_node = this->impl_delete(node->left_node, value, deleted);
+            if (!deleted) {
+                return node;
+            }
+            this->impl_retire(node);
+            return this->impl_balance(node->value, new_left_node, node->right_node);
+        }
+        if (node->value < value) {
+            Node const* new_right_node = this->impl_delete(node->right_node, value, deleted);
+            if (!deleted) {
+                return node;
+            }
+            this->impl_retire(node);
+            return this->impl_balance(node->value, node->left_node, new_right_node);
+        }
+
+        deleted = true;
+        this->impl_retire(node);
+        if (node->left_node == nullptr) {
+            return node->right_node;
+        }
+        if (node->right_node == nullptr) {
+            return node->left_node;
+        }
+
+        T           successor_value;
+        Node const* new_right_node = this->impl_delete_min(node->right_node, successor_value);
+        return this->impl_balance(successor_value, node->left_node, new_right_node);
+    }
+};
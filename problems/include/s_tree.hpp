@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "common.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Static B+ tree (S+ tree) over a set of integers, where every node is a single cache line holding
+// as many keys as fit in it (16 for 32-bit keys) and its children are found by arithmetic rather
+// than stored indices.
+//
+// The leaves hold all the keys, sorted and contiguous. Each key of an inner node is the smallest key
+// of the subtree to its right, so the child to descend to is the count of the keys of the node that
+// are less than the value. That count is computed for the whole node at once, with AVX2 compares and
+// movemasks where available, and the tree is shallower than a binary tree by a factor of log2 of
+// the node size: a lookup costs a cache miss every 4 levels of a binary search for 32-bit keys.
+//
+// The layers are stored one after the other starting from the leaves, padded with the largest value
+// of T.
+template <typename T>
+    requires std::is_integral_v<T>
+struct STree {
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+
+    static constexpr size_t KEYS_PER_NODE = CACHE_LINE_SIZE / sizeof(T);
+
+    static constexpr T PADDING_VALUE = std::numeric_limits<T>::max();
+
+    static constexpr size_t node_count_of(size_t key_count) {
+        return (key_count + KEYS_PER_NODE - 1) / KEYS_PER_NODE;
+    }
+
+    // Count of keys of the layer above a layer holding the given count of keys.
+    static constexpr size_t parent_key_count_of(size_t key_count) {
+        return ((node_count_of(key_count) + KEYS_PER_NODE) / (KEYS_PER_NODE + 1)) * KEYS_PER_NODE;
+    }
+
+    // Offset of the first key of the node to descend to, given the offset of the current node in
+    // its layer and the rank of the value in it.
+    static constexpr size_t child_key_offset(size_t key_offset, size_t rank) {
+        return key_offset * (KEYS_PER_NODE + 1) + rank * KEYS_PER_NODE;
+    }
+
+    // Counts the keys of the node that are less than the value.
+    static size_t rank_in_node(T const* node, T value) {
+#if defined(__AVX2__)
+        if constexpr (std::is_same_v<T, int32_t>) {
+            __m256i value_vec = _mm256_set1_epi32(value);
+            __m256i less_low  = _mm256_cmpgt_epi32(value_vec, _mm256_load_si256(reinterpret_cast<__m256i const*>(node)));
+            __m256i less_high = _mm256_cmpgt_epi32(value_vec, _mm256_load_si256(reinterpret_cast<__m256i const*>(node + 8)));
+            uint32_t mask     = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(less_low)))
+                            | (static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(less_high))) << 8);
+            return static_cast<size_t>(std::popcount(mask));
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+            __m256i value_vec = _mm256_set1_epi64x(value);
+            __m256i less_low  = _mm256_cmpgt_epi64(value_vec, _mm256_load_si256(reinterpret_cast<__m256i const*>(node)));
+            __m256i less_high = _mm256_cmpgt_epi64(value_vec, _mm256_load_si256(reinterpret_cast<__m256i const*>(node + 4)));
+            uint32_t mask     = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(less_low)))
+                            | (static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(less_high))) << 4);
+            return static_cast<size_t>(std::popcount(mask));
+        }
+#endif
+
+        // Branchless, so that compilers can vectorize it on their own.
+        size_t rank = 0;
+        for (size_t idx = 0; idx < KEYS_PER_NODE; ++idx) {
+            rank += static_cast<size_t>(node[idx] < value);
+        }
+        return rank;
+    }
+
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    std::vector<T, CacheLineAllocator<T>> keys;
+
+    // Offset of the first key of each layer, starting from the leaves.
+    std::vector<size_t> layer_offsets;
+
+    size_t key_count = 0;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    STree()  = delete;
+    ~STree() = default;
+
+    // The keys must be sorted in ascending order.
+    explicit STree(std::vector<T> const& sorted_keys) {
+        assert(std::is_sorted(sorted_keys.begin(), sorted_keys.end()));
+
+        this->key_count = sorted_keys.size();
+
+        size_t total_key_count = 0;
+        size_t layer_key_count = node_count_of(this->key_count) * KEYS_PER_NODE;
+        do {
+            this->layer_offsets.push_back(total_key_count);
+            total_key_count += layer_key_count;
+            if (layer_key_count <= KEYS_PER_NODE) {
+                break;
+            }
+            layer_key_count = parent_key_count_of(layer_key_count);
+        } while (true);
+
+        this->keys.assign(total_key_count, PADDING_VALUE);
+        std::copy(sorted_keys.begin(), sorted_keys.end(), this->keys.begin());
+
+        for (size_t layer = 1; layer < this->layer_offsets.size(); ++layer) {
+            size_t layer_offset = this->layer_offsets[layer];
+            size_t layer_end    = (layer + 1 < this->layer_offsets.size()) ? this->layer_offsets[layer + 1] : total_key_count;
+
+            for (size_t key_idx = 0; key_idx < layer_end - layer_offset; ++key_idx) {
+                // Take the leftmost leaf of the subtree to the right of the key.
+                size_t node_idx = (key_idx / KEYS_PER_NODE) * (KEYS_PER_NODE + 1) + (key_idx % KEYS_PER_NODE) + 1;
+                for (size_t below = 1; below < layer; ++below) {
+                    node_idx *= KEYS_PER_NODE + 1;
+                }
+
+                size_t leaf_offset                 = node_idx * KEYS_PER_NODE;
+                this->keys[layer_offset + key_idx] = (leaf_offset < this->key_count) ? this->keys[leaf_offset] : PADDING_VALUE;
+            }
+        }
+    }
+
+    size_t size() const {
+        return this->key_count;
+    }
+
+    // Returns the smallest key not less than the value, or nullptr if there's none.
+    T const* lower_bound(T value) const {
+        if (this->key_count == 0) {
+            return nullptr;
+        }
+
+        T const* layers     = this->keys.data();
+        size_t   key_offset = 0;
+        for (size_t layer = this->layer_offsets.size() - 1; layer > 0; --layer) {
+            size_t rank = rank_in_node(layers + this->layer_offsets[layer] + key_offset, value);
+            key_offset  = child_key_offset(key_offset, rank);
+        }
+
+        // If all the keys of the leaf are less than the value, this lands on the first key of the
+        // next leaf, which is the smallest key of the next subtree.
+        size_t leaf_idx = key_offset + rank_in_node(layers + key_offset, value);
+        return (leaf_idx < this->key_count) ? &this->keys[leaf_idx] : nullptr;
+    }
+
+    bool contains(T value) const {
+        T const* found = this->lower_bound(value);
+        return (found != nullptr) && (*found == value);
+    }
+};
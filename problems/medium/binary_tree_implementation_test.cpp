@@ -1,8 +1,32 @@
 #include <binary_tree.hpp>
 #include <common.hpp>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Checks the AVL invariant, heights and subtree sizes of every node reachable from the root.
+template <typename Tree>
+static void assert_balanced(Tree const& tree, int32_t node_idx) {
+    if (node_idx < 0) {
+        return;
+    }
+
+    auto const& node = tree.memory[static_cast<size_t>(node_idx)];
+    assert_balanced(tree, node.left_node_idx);
+    assert_balanced(tree, node.right_node_idx);
+
+    int32_t left_height  = tree.impl_height(node.left_node_idx);
+    int32_t right_height = tree.impl_height(node.right_node_idx);
+    assert_eq(node.height, 1 + max_value(left_height, right_height));
+    assert_eq(left_height - right_height <= 1 && right_height - left_height <= 1, true);
+    assert_eq(node.subtree_size, 1 + tree.impl_subtree_size(node.left_node_idx) + tree.impl_subtree_size(node.right_node_idx));
+}
 
 int main() {
-    // [5, 2, 6, 1, 3, ., 9, -3, .]
     BinaryTree<int32_t> bt{5, 3};
 
     assert_eq(bt.insert_node(5), BinaryTree<int32_t>::NODE_ALREADY_EXISTS);
@@ -11,8 +35,8 @@ int main() {
 
         assert_eq(bt.find_node(-10), BinaryTree<int32_t>::INVALID_NODE_INDEX);
 
-        assert_eq(bt.min(), 5);
-        assert_eq(bt.max(), 5);
+        assert_eq(*bt.min(), 5);
+        assert_eq(*bt.max(), 5);
 
         assert_eq(bt.max_depth(), 1);
     }
@@ -26,8 +50,8 @@ int main() {
         assert_eq(bt.find_node(9), BinaryTree<int32_t>::INVALID_NODE_INDEX);
         assert_eq(bt.find_node(-39), BinaryTree<int32_t>::INVALID_NODE_INDEX);
 
-        assert_eq(bt.min(), 2);
-        assert_eq(bt.max(), 5);
+        assert_eq(*bt.min(), 2);
+        assert_eq(*bt.max(), 5);
 
         assert_eq(bt.max_depth(), 2);
     }
@@ -41,8 +65,8 @@ int main() {
         assert_eq(bt.find_node(-1), BinaryTree<int32_t>::INVALID_NODE_INDEX);
         assert_eq(bt.find_node(1), BinaryTree<int32_t>::INVALID_NODE_INDEX);
 
-        assert_eq(bt.min(), 2);
-        assert_eq(bt.max(), 6);
+        assert_eq(*bt.min(), 2);
+        assert_eq(*bt.max(), 6);
 
         assert_eq(bt.max_depth(), 2);
     }
@@ -57,27 +81,27 @@ int main() {
         assert_eq(bt.find_node(9), BinaryTree<int32_t>::INVALID_NODE_INDEX);
         assert_eq(bt.find_node(-39), BinaryTree<int32_t>::INVALID_NODE_INDEX);
 
-        assert_eq(bt.min(), 1);
-        assert_eq(bt.max(), 6);
+        assert_eq(*bt.min(), 1);
+        assert_eq(*bt.max(), 6);
 
         assert_eq(bt.max_depth(), 3);
     }
 
-    assert_eq(bt.insert_node(-3), 7);
+    assert_eq(bt.insert_node(-3), 4);
     {
         assert_eq(bt.find_node(5), 0);
         assert_eq(bt.find_node(2), 1);
         assert_eq(bt.find_node(6), 2);
         assert_eq(bt.find_node(1), 3);
-        assert_eq(bt.find_node(-3), 7);
+        assert_eq(bt.find_node(-3), 4);
 
         assert_eq(bt.find_node(-2), BinaryTree<int32_t>::INVALID_NODE_INDEX);
         assert_eq(bt.find_node(0), BinaryTree<int32_t>::INVALID_NODE_INDEX);
 
-        assert_eq(bt.min(), -3);
-        assert_eq(bt.max(), 6);
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 6);
 
-        assert_eq(bt.max_depth(), 4);
+        assert_eq(bt.max_depth(), 3);
     }
 
     assert_eq(bt.insert_node(-3), BinaryTree<int32_t>::NODE_ALREADY_EXISTS);
@@ -86,30 +110,30 @@ int main() {
         assert_eq(bt.find_node(2), 1);
         assert_eq(bt.find_node(6), 2);
         assert_eq(bt.find_node(1), 3);
-        assert_eq(bt.find_node(-3), 7);
+        assert_eq(bt.find_node(-3), 4);
 
         assert_eq(bt.find_node(100), BinaryTree<int32_t>::INVALID_NODE_INDEX);
         assert_eq(bt.find_node(98), BinaryTree<int32_t>::INVALID_NODE_INDEX);
 
-        assert_eq(bt.min(), -3);
-        assert_eq(bt.max(), 6);
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 6);
 
-        assert_eq(bt.max_depth(), 4);
+        assert_eq(bt.max_depth(), 3);
     }
 
-    assert_eq(bt.insert_node(3), 4);
+    assert_eq(bt.insert_node(3), 5);
     {
         assert_eq(bt.find_node(5), 0);
         assert_eq(bt.find_node(2), 1);
         assert_eq(bt.find_node(6), 2);
         assert_eq(bt.find_node(1), 3);
-        assert_eq(bt.find_node(3), 4);
-        assert_eq(bt.find_node(-3), 7);
+        assert_eq(bt.find_node(3), 5);
+        assert_eq(bt.find_node(-3), 4);
 
-        assert_eq(bt.min(), -3);
-        assert_eq(bt.max(), 6);
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 6);
 
-        assert_eq(bt.max_depth(), 4);
+        assert_eq(bt.max_depth(), 3);
     }
 
     assert_eq(bt.insert_node(5), BinaryTree<int32_t>::NODE_ALREADY_EXISTS);
@@ -118,13 +142,13 @@ int main() {
         assert_eq(bt.find_node(2), 1);
         assert_eq(bt.find_node(6), 2);
         assert_eq(bt.find_node(1), 3);
-        assert_eq(bt.find_node(3), 4);
-        assert_eq(bt.find_node(-3), 7);
+        assert_eq(bt.find_node(3), 5);
+        assert_eq(bt.find_node(-3), 4);
 
-        assert_eq(bt.min(), -3);
-        assert_eq(bt.max(), 6);
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 6);
 
-        assert_eq(bt.max_depth(), 4);
+        assert_eq(bt.max_depth(), 3);
     }
 
     assert_eq(bt.insert_node(9), 6);
@@ -133,12 +157,12 @@ int main() {
         assert_eq(bt.find_node(2), 1);
         assert_eq(bt.find_node(6), 2);
         assert_eq(bt.find_node(1), 3);
-        assert_eq(bt.find_node(3), 4);
+        assert_eq(bt.find_node(3), 5);
         assert_eq(bt.find_node(9), 6);
-        assert_eq(bt.find_node(-3), 7);
+        assert_eq(bt.find_node(-3), 4);
 
-        assert_eq(bt.min(), -3);
-        assert_eq(bt.max(), 9);
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 9);
 
         assert_eq(bt.max_depth(), 4);
     }
@@ -149,16 +173,546 @@ int main() {
         assert_eq(bt.find_node(2), 1);
         assert_eq(bt.find_node(6), 2);
         assert_eq(bt.find_node(1), 3);
-        assert_eq(bt.find_node(3), 4);
+        assert_eq(bt.find_node(3), 5);
         assert_eq(bt.find_node(9), 6);
-        assert_eq(bt.find_node(-3), 7);
+        assert_eq(bt.find_node(-3), 4);
 
-        assert_eq(bt.min(), -3);
-        assert_eq(bt.max(), 9);
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 9);
 
         assert_eq(bt.max_depth(), 4);
     }
 
+    // Deleting a node with a single child, which unbalances the root, then nodes with two children.
+    assert_eq(bt.delete_node(42), false);
+    assert_eq(bt.delete_node(1), true);
+    assert_eq(bt.delete_node(1), false);
+    {
+        assert_eq(bt.find_node(1), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+        assert_eq(bt.find_node(-3), 4);
+
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 9);
+
+        assert_eq(bt.max_depth(), 3);
+    }
+
+    assert_eq(bt.delete_node(2), true);
+    assert_eq(bt.delete_node(5), true);
+    {
+        // The remaining values keep their indices.
+        assert_eq(bt.find_node(-3), 4);
+        assert_eq(bt.find_node(3), 5);
+        assert_eq(bt.find_node(6), 2);
+        assert_eq(bt.find_node(9), 6);
+
+        assert_eq(bt.find_node(2), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+        assert_eq(bt.find_node(5), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+
+        assert_eq(*bt.min(), -3);
+        assert_eq(*bt.max(), 9);
+
+        assert_eq(bt.max_depth(), 3);
+    }
+
+    assert_eq(bt.delete_node(9), true);
+    assert_eq(bt.delete_node(-3), true);
+    assert_eq(bt.delete_node(3), true);
+    assert_eq(bt.delete_node(6), true);
+    {
+        assert_eq(bt.find_node(6), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+
+        assert_eq(bt.min() == nullptr, true);
+        assert_eq(bt.max() == nullptr, true);
+
+        assert_eq(bt.max_depth(), 0);
+    }
+
+    // The tree can be refilled after being emptied, reusing the slots of the deleted nodes.
+    assert_eq(bt.insert_node(7) >= 0, true);
+    {
+        assert_eq(bt.memory.size(), size_t{7});
+
+        assert_eq(*bt.min(), 7);
+        assert_eq(*bt.max(), 7);
+
+        assert_eq(bt.max_depth(), 1);
+    }
+
+    // Sorted insertions would degenerate an unbalanced tree into a list, the AVL tree keeps its
+    // depth logarithmic: at most 1.44 * log2(n + 2).
+    {
+        constexpr int32_t VALUE_COUNT = 1000;
+
+        BinaryTree<int32_t> sorted{0, VALUE_COUNT};
+        for (int32_t value = 1; value < VALUE_COUNT; ++value) {
+            assert_eq(sorted.insert_node(value), value);
+        }
+
+        assert_eq(*sorted.min(), 0);
+        assert_eq(*sorted.max(), VALUE_COUNT - 1);
+        assert_eq(sorted.max_depth() <= 14, true);
+
+        for (int32_t value = 0; value < VALUE_COUNT; ++value) {
+            assert_eq(sorted.find_node(value), value);
+        }
+
+        // Delete the even values in decreasing order.
+        for (int32_t value = VALUE_COUNT - 2; value >= 0; value -= 2) {
+            assert_eq(sorted.delete_node(value), true);
+        }
+
+        for (int32_t value = 0; value < VALUE_COUNT; ++value) {
+            int32_t expected = (value % 2 == 0) ? BinaryTree<int32_t>::INVALID_NODE_INDEX : value;
+            assert_eq(sorted.find_node(value), expected);
+        }
+
+        assert_eq(*sorted.min(), 1);
+        assert_eq(*sorted.max(), VALUE_COUNT - 1);
+        assert_eq(sorted.max_depth() <= 13, true);
+    }
+
+    // The memory grows with the count of values, whatever the depth of the path to new nodes.
+    {
+        constexpr int32_t VALUE_COUNT = 64;
+
+        BinaryTree<int64_t> sorted{0, 1};
+        for (int64_t value = 1; value < VALUE_COUNT; ++value) {
+            assert_eq(sorted.insert_node(value), static_cast<int32_t>(value));
+        }
+        assert_eq(sorted.memory.size(), size_t{VALUE_COUNT});
+
+        // Freed slots are taken before growing the memory again.
+        assert_eq(sorted.delete_node(10), true);
+        assert_eq(sorted.delete_node(20), true);
+        assert_eq(sorted.insert_node(100), 20);
+        assert_eq(sorted.insert_node(101), 10);
+        assert_eq(sorted.insert_node(102), VALUE_COUNT);
+        assert_eq(sorted.memory.size(), size_t{VALUE_COUNT + 1});
+
+        assert_eq(sorted.find_node(10), BinaryTree<int64_t>::INVALID_NODE_INDEX);
+        assert_eq(sorted.find_node(101), 10);
+        assert_eq(*sorted.min(), int64_t{0});
+        assert_eq(*sorted.max(), int64_t{102});
+    }
+
+    // Bulk building from sorted values gives a perfectly balanced tree laid out in pre-order.
+    {
+        std::vector<int32_t> values = {1, 2, 3, 4, 5, 6, 7};
+        BinaryTree<int32_t>  built{values};
+
+        assert_eq(built.root_node_idx, 0);
+        assert_eq(built.find_node(4), 0);
+        assert_eq(built.find_node(2), 1);
+        assert_eq(built.find_node(1), 2);
+        assert_eq(built.find_node(3), 3);
+        assert_eq(built.find_node(6), 4);
+        assert_eq(built.find_node(5), 5);
+        assert_eq(built.find_node(7), 6);
+
+        assert_eq(*built.min(), 1);
+        assert_eq(*built.max(), 7);
+        assert_eq(built.max_depth(), size_t{3});
+
+        // The tree stays an ordinary tree afterwards.
+        assert_eq(built.insert_node(8), 7);
+        assert_eq(built.delete_node(4), true);
+        assert_eq(built.find_node(4), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+        assert_eq(built.max_depth(), size_t{3});
+    }
+
+    // Unsorted values with duplicates are sorted and deduplicated.
+    {
+        std::vector<int32_t> values = {9, -1, 4, 9, 0, 4, 4, 12};
+        BinaryTree<int32_t>  built{values};
+
+        assert_eq(built.memory.size(), size_t{5});
+        assert_eq(*built.min(), -1);
+        assert_eq(*built.max(), 12);
+        for (int32_t value : values) {
+            assert_eq(built.find_node(value) >= 0, true);
+        }
+        assert_eq(built.find_node(1), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+    }
+
+    {
+        BinaryTree<int32_t> built{std::span<int32_t const>{}};
+        assert_eq(built.max_depth(), size_t{0});
+        assert_eq(built.find_node(0), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+        assert_eq(built.insert_node(3), 0);
+        assert_eq(*built.min(), 3);
+    }
+
+    // Large enough to be built in parallel.
+    {
+        constexpr int32_t VALUE_COUNT = (1 << 20) - 1;
+
+        std::vector<int32_t> values(VALUE_COUNT);
+        for (int32_t idx = 0; idx < VALUE_COUNT; ++idx) {
+            values[static_cast<size_t>(idx)] = 2 * idx;
+        }
+
+        BinaryTree<int32_t> built{values};
+        assert_eq(built.max_depth(), size_t{20});
+        assert_eq(*built.select(VALUE_COUNT / 2), VALUE_COUNT - 1);
+        assert_eq(built.rank(VALUE_COUNT), static_cast<size_t>(VALUE_COUNT / 2 + 1));
+        assert_eq(*built.min(), 0);
+        assert_eq(*built.max(), 2 * (VALUE_COUNT - 1));
+        for (int32_t idx = 0; idx < VALUE_COUNT; idx += 997) {
+            assert_eq(built.find_node(2 * idx) >= 0, true);
+            assert_eq(built.find_node(2 * idx + 1), BinaryTree<int32_t>::INVALID_NODE_INDEX);
+        }
+    }
+
+    // Random insertions and deletions against std::set, checking the AVL invariant and the size.
+    {
+        BinaryTree<int32_t> random_tree{std::span<int32_t const>{}};
+        std::set<int32_t>   expected;
+
+        std::mt19937                           rng{1234};
+        std::uniform_int_distribution<int32_t> value_distribution{0, 2000};
+        for (size_t operation = 0; operation < 50'000; ++operation) {
+            int32_t value = value_distribution(rng);
+            if (rng() % 3 == 0) {
+                assert_eq(random_tree.delete_node(value), expected.erase(value) == 1);
+            } else {
+                assert_eq(random_tree.insert_node(value) >= 0, expected.insert(value).second);
+            }
+            assert_eq(random_tree.size(), expected.size());
+        }
+
+        for (int32_t value = 0; value <= 2000; ++value) {
+            assert_eq(random_tree.find_node(value) >= 0, expected.contains(value));
+        }
+
+        // Every node must be balanced and hold the height of its subtree.
+        for (int32_t node_idx = 0; node_idx < static_cast<int32_t>(random_tree.memory.size()); ++node_idx) {
+            auto const& [left_idx, right_idx, height, subtree_size, value] = random_tree.memory[static_cast<size_t>(node_idx)];
+            if (random_tree.find_node(value) != node_idx) {
+                // A free slot.
+                continue;
+            }
+            int32_t left_height  = random_tree.impl_height(left_idx);
+            int32_t right_height = random_tree.impl_height(right_idx);
+            assert_eq(height, 1 + max_value(left_height, right_height));
+            assert_eq(left_height - right_height <= 1 && right_height - left_height <= 1, true);
+            assert_eq(subtree_size, 1 + random_tree.impl_subtree_size(left_idx) + random_tree.impl_subtree_size(right_idx));
+        }
+
+        // Order statistics agree with the sorted values.
+        std::vector<int32_t> sorted_values(expected.begin(), expected.end());
+        for (size_t k = 0; k < sorted_values.size(); ++k) {
+            assert_eq(*random_tree.select(k), sorted_values[k]);
+            assert_eq(random_tree.rank(sorted_values[k]), k);
+        }
+        assert_eq(random_tree.select(sorted_values.size()) == nullptr, true);
+        for (int32_t value = -1; value <= 2001; ++value) {
+            size_t expected_rank = static_cast<size_t>(std::lower_bound(sorted_values.begin(), sorted_values.end(), value) - sorted_values.begin());
+            assert_eq(random_tree.rank(value), expected_rank);
+        }
+    }
+
+    // In-order iteration and range queries.
+    {
+        static_assert(std::forward_iterator<BinaryTree<int32_t>::Iterator>);
+
+        std::vector<int32_t> values = {40, 10, 70, 30, 20, 60, 50};
+        BinaryTree<int32_t>  tree{values[0], values.size()};
+        for (int32_t value : values) {
+            tree.insert_node(value);
+        }
+        assert_eq(tree.delete_node(60), true);
+
+        std::vector<int32_t> visited(tree.begin(), tree.end());
+        debug::vec_assert_eq(visited, std::vector<int32_t>{10, 20, 30, 40, 50, 70});
+
+        assert_eq(*tree.lower_bound(25), 30);
+        assert_eq(*tree.lower_bound(30), 30);
+        assert_eq(*tree.lower_bound(-5), 10);
+        assert_eq(tree.lower_bound(71) == tree.end(), true);
+
+        std::vector<int32_t> in_range;
+        tree.range(20, 50, [&](int32_t value) { in_range.push_back(value); });
+        debug::vec_assert_eq(in_range, std::vector<int32_t>{20, 30, 40});
+
+        in_range.clear();
+        tree.range(41, 49, [&](int32_t value) { in_range.push_back(value); });
+        assert_eq(in_range.empty(), true);
+
+        in_range.clear();
+        tree.range(55, 1000, [&](int32_t value) { in_range.push_back(value); });
+        debug::vec_assert_eq(in_range, std::vector<int32_t>{70});
+
+        BinaryTree<int32_t> empty{std::span<int32_t const>{}};
+        assert_eq(empty.begin() == empty.end(), true);
+    }
+
+    // Ranges of a large tree match a sorted scan.
+    {
+        std::vector<int32_t> values(100'000);
+        std::mt19937         rng{99};
+        for (int32_t& value : values) {
+            value = static_cast<int32_t>(rng() % 1'000'000);
+        }
+
+        BinaryTree<int32_t> tree{values};
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+
+        std::vector<int32_t> visited(tree.begin(), tree.end());
+        debug::vec_assert_eq(visited, values);
+
+        for (size_t query = 0; query < 100; ++query) {
+            int32_t low  = static_cast<int32_t>(rng() % 1'000'000);
+            int32_t high = low + static_cast<int32_t>(rng() % 50'000);
+
+            std::vector<int32_t> in_range;
+            tree.range(low, high, [&](int32_t value) { in_range.push_back(value); });
+
+            auto first = std::lower_bound(values.begin(), values.end(), low);
+            auto last  = std::lower_bound(values.begin(), values.end(), high);
+            debug::vec_assert_eq(in_range, std::vector<int32_t>(first, last));
+        }
+    }
+
+    // Batched lookups agree with single ones, whatever the size of the batch.
+    {
+        std::mt19937        rng{5};
+        BinaryTree<int32_t> tree{std::span<int32_t const>{}};
+        for (size_t idx = 0; idx < 10'000; ++idx) {
+            tree.insert_node(static_cast<int32_t>(rng() % 30'000));
+        }
+
+        for (size_t batch_size : {size_t{0}, size_t{1}, size_t{7}, size_t{16}, size_t{17}, size_t{5000}}) {
+            std::vector<int32_t> values(batch_size);
+            for (int32_t& value : values) {
+                value = static_cast<int32_t>(rng() % 30'000);
+            }
+
+            std::vector<int32_t> node_indices(batch_size);
+            tree.find_batch(values, node_indices);
+            for (size_t idx = 0; idx < batch_size; ++idx) {
+                assert_eq(node_indices[idx], tree.find_node(values[idx]));
+            }
+        }
+
+        BinaryTree<int32_t>  empty{std::span<int32_t const>{}};
+        std::vector<int32_t> values = {1, 2, 3};
+        std::vector<int32_t> node_indices(values.size());
+        empty.find_batch(values, node_indices);
+        debug::vec_assert_eq(node_indices, std::vector<int32_t>(values.size(), BinaryTree<int32_t>::INVALID_NODE_INDEX));
+    }
+
+    // Keys mapped to values, looked up by string views without building strings.
+    {
+        using StringMap = BinaryTree<std::string, int32_t, std::less<>>;
+        static_assert(StringMap::IS_TRANSPARENT);
+
+        StringMap map{std::span<std::string const>{}, std::span<int32_t const>{}};
+        assert_eq(map.insert_node("pear", 3) >= 0, true);
+        assert_eq(map.insert_node("apple", 1) >= 0, true);
+        assert_eq(map.insert_node("fig", 2) >= 0, true);
+        assert_eq(map.insert_node("apple", 10), StringMap::NODE_ALREADY_EXISTS);
+
+        std::string_view fig = "fig";
+        assert_eq(*map.find_value(fig), 2);
+        assert_eq(*map.find_value(std::string_view{"apple"}), 1);
+        assert_eq(map.find_value(std::string_view{"kiwi"}) == nullptr, true);
+        assert_eq(map.rank(std::string_view{"banana"}), size_t{1});
+        assert_eq(*map.lower_bound(std::string_view{"g"}), std::string{"pear"});
+
+        *map.find_value(fig) = 20;
+        assert_eq(map.values[static_cast<size_t>(map.find_node(fig))], 20);
+
+        std::vector<std::string> keys;
+        std::vector<int32_t>     values;
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            keys.push_back(*it);
+            values.push_back(it.value());
+        }
+        debug::vec_assert_eq(keys, std::vector<std::string>{"apple", "fig", "pear"});
+        debug::vec_assert_eq(values, std::vector<int32_t>{1, 20, 3});
+
+        // A reused slot takes the value of the new key.
+        assert_eq(map.delete_node(std::string_view{"fig"}), true);
+        assert_eq(map.find_value(fig) == nullptr, true);
+        assert_eq(map.insert_node("kiwi", 4) >= 0, true);
+        assert_eq(*map.find_value(std::string_view{"kiwi"}), 4);
+        assert_eq(map.memory.size(), map.values.size());
+    }
+
+    // Bulk built maps keep the first value of repeated keys.
+    {
+        std::vector<int32_t>     keys   = {5, 1, 5, 3, 1};
+        std::vector<std::string> values = {"a", "b", "c", "d", "e"};
+
+        BinaryTree<int32_t, std::string> map{keys, values};
+        assert_eq(map.size(), size_t{3});
+        assert_eq(*map.find_value(1), std::string{"b"});
+        assert_eq(*map.find_value(3), std::string{"d"});
+        assert_eq(*map.find_value(5), std::string{"a"});
+
+        std::vector<int32_t>     sorted_keys   = {1, 2, 3, 4, 5, 6, 7};
+        std::vector<std::string> sorted_values = {"1", "2", "3", "4", "5", "6", "7"};
+
+        BinaryTree<int32_t, std::string> sorted_map{sorted_keys, sorted_values};
+        for (size_t idx = 0; idx < sorted_keys.size(); ++idx) {
+            assert_eq(*sorted_map.find_value(sorted_keys[idx]), sorted_values[idx]);
+        }
+    }
+
+    // Custom comparators order the keys, which need neither numeric limits nor an equality operator.
+    {
+        std::vector<int32_t>                                values = {3, 1, 4, 1, 5, 9, 2, 6};
+        BinaryTree<int32_t, NoValue, std::greater<int32_t>> descending{values};
+
+        std::vector<int32_t> visited(descending.begin(), descending.end());
+        debug::vec_assert_eq(visited, std::vector<int32_t>{9, 6, 5, 4, 3, 2, 1});
+        assert_eq(*descending.min(), 9);
+        assert_eq(*descending.max(), 1);
+        assert_eq(*descending.select(1), 6);
+        assert_eq(descending.rank(4), size_t{3});
+
+        struct Point {
+            int32_t x;
+            int32_t y;
+        };
+        auto by_x_then_y = [](Point const& lhs, Point const& rhs) { return std::pair{lhs.x, lhs.y} < std::pair{rhs.x, rhs.y}; };
+
+        BinaryTree<Point, NoValue, decltype(by_x_then_y)> points{Point{1, 2}, 4};
+        points.insert_node(Point{0, 5});
+        points.insert_node(Point{1, 1});
+        assert_eq(points.insert_node(Point{1, 2}), (BinaryTree<Point, NoValue, decltype(by_x_then_y)>::NODE_ALREADY_EXISTS));
+        assert_eq(points.min()->x, 0);
+        assert_eq(points.select(1)->y, 1);
+        assert_eq(points.find_node(Point{1, 1}) >= 0, true);
+    }
+
+    // Splitting and joining back.
+    {
+        std::vector<int32_t> values;
+        for (int32_t value = 0; value < 2000; value += 2) {
+            values.push_back(value);
+        }
+
+        BinaryTree<int32_t> tree{values};
+        BinaryTree<int32_t> greater = tree.split(1001);
+        assert_eq(tree.size(), size_t{501});
+        assert_eq(greater.size(), size_t{499});
+        assert_eq(*tree.max(), 1000);
+        assert_eq(*greater.min(), 1002);
+        assert_balanced(tree, tree.root_node_idx);
+        assert_balanced(greater, greater.root_node_idx);
+
+        // Splitting by a key in the tree moves it out with the greater ones.
+        BinaryTree<int32_t> middle = tree.split(500);
+        assert_eq(*middle.min(), 500);
+        assert_eq(*tree.max(), 498);
+        assert_balanced(tree, tree.root_node_idx);
+
+        // The slots of the keys moved out are reused before the memory grows.
+        size_t memory_size = tree.memory.size();
+        for (int32_t value = 501; value < 1000; value += 2) {
+            tree.insert_node(value);
+        }
+        assert_eq(tree.memory.size(), memory_size);
+        assert_balanced(tree, tree.root_node_idx);
+
+        BinaryTree<int32_t> small{std::span<int32_t const>{}};
+        small.insert_node(-1);
+        small.join(std::move(tree));
+        small.join(std::move(greater));
+        assert_eq(small.size(), size_t{1 + 250 + 250 + 499});
+        assert_balanced(small, small.root_node_idx);
+
+        std::vector<int32_t> expected = {-1};
+        for (int32_t value = 0; value < 500; value += 2) {
+            expected.push_back(value);
+        }
+        for (int32_t value = 501; value < 1000; value += 2) {
+            expected.push_back(value);
+        }
+        for (int32_t value = 1002; value < 2000; value += 2) {
+            expected.push_back(value);
+        }
+        debug::vec_assert_eq(std::vector<int32_t>(small.begin(), small.end()), expected);
+    }
+
+    // Set operations against the standard algorithms, for operands of similar and very different sizes.
+    {
+        std::mt19937 rng{77};
+        auto         random_values = [&](size_t count, uint32_t key_range) {
+            std::vector<int32_t> values(count);
+            for (int32_t& value : values) {
+                value = static_cast<int32_t>(rng() % key_range);
+            }
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+            return values;
+        };
+
+        for (auto [lhs_count, rhs_count] : {std::pair{size_t{0}, size_t{100}}, std::pair{size_t{1000}, size_t{1000}},
+                                            std::pair{size_t{50'000}, size_t{30}}, std::pair{size_t{20}, size_t{40'000}},
+                                            std::pair{size_t{100'000}, size_t{80'000}}}) {
+            std::vector<int32_t> lhs_values = random_values(lhs_count, 200'000);
+            std::vector<int32_t> rhs_values = random_values(rhs_count, 200'000);
+
+            std::vector<int32_t> expected;
+            std::set_union(lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(), std::back_inserter(expected));
+            BinaryTree<int32_t> result = BinaryTree<int32_t>::set_union(BinaryTree<int32_t>{lhs_values}, BinaryTree<int32_t>{rhs_values});
+            debug::vec_assert_eq(std::vector<int32_t>(result.begin(), result.end()), expected);
+            assert_eq(result.size(), expected.size());
+            assert_balanced(result, result.root_node_idx);
+
+            expected.clear();
+            std::set_intersection(lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(), std::back_inserter(expected));
+            result = BinaryTree<int32_t>::set_intersection(BinaryTree<int32_t>{lhs_values}, BinaryTree<int32_t>{rhs_values});
+            debug::vec_assert_eq(std::vector<int32_t>(result.begin(), result.end()), expected);
+            assert_eq(result.size(), expected.size());
+            assert_balanced(result, result.root_node_idx);
+
+            expected.clear();
+            std::set_difference(lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(), std::back_inserter(expected));
+            result = BinaryTree<int32_t>::set_difference(BinaryTree<int32_t>{lhs_values}, BinaryTree<int32_t>{rhs_values});
+            debug::vec_assert_eq(std::vector<int32_t>(result.begin(), result.end()), expected);
+            assert_eq(result.size(), expected.size());
+            assert_balanced(result, result.root_node_idx);
+
+            // The result keeps working as a tree, reusing the slots of the dropped nodes.
+            for (int32_t value : rhs_values) {
+                result.insert_node(value);
+            }
+            for (int32_t value : lhs_values) {
+                result.delete_node(value);
+            }
+            expected.clear();
+            std::set_difference(rhs_values.begin(), rhs_values.end(), lhs_values.begin(), lhs_values.end(), std::back_inserter(expected));
+            debug::vec_assert_eq(std::vector<int32_t>(result.begin(), result.end()), expected);
+            assert_balanced(result, result.root_node_idx);
+        }
+    }
+
+    // Keys of both maps keep the values of the left hand side one.
+    {
+        std::vector<int32_t> lhs_keys   = {1, 2, 3};
+        std::vector<int32_t> lhs_values = {10, 20, 30};
+        std::vector<int32_t> rhs_keys   = {2, 3, 4, 5, 6, 7, 8};
+        std::vector<int32_t> rhs_values = {200, 300, 400, 500, 600, 700, 800};
+
+        using Map = BinaryTree<int32_t, int32_t>;
+        Map merged = Map::set_union(Map{lhs_keys, lhs_values}, Map{rhs_keys, rhs_values});
+        std::vector<int32_t> merged_values;
+        for (auto it = merged.begin(); it != merged.end(); ++it) {
+            merged_values.push_back(it.value());
+        }
+        debug::vec_assert_eq(merged_values, std::vector<int32_t>{10, 20, 30, 400, 500, 600, 700, 800});
+
+        Map common = Map::set_intersection(Map{rhs_keys, rhs_values}, Map{lhs_keys, lhs_values});
+        assert_eq(common.size(), size_t{2});
+        assert_eq(*common.find_value(2), 200);
+        assert_eq(*common.find_value(3), 300);
+    }
+
     report_success();
     return 0;
 }
@@ -0,0 +1,101 @@
+#include <atomic>
+#include <common.hpp>
+#include <concurrent_binary_tree.hpp>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+int main() {
+    // Single threaded, against std::set.
+    {
+        ConcurrentBinaryTree<int32_t> tree;
+        std::set<int32_t>             expected;
+
+        assert_eq(tree.contains(0), false);
+
+        std::mt19937 rng{3};
+        for (size_t operation = 0; operation < 100'000; ++operation) {
+            int32_t value = static_cast<int32_t>(rng() % 5000);
+            if (rng() % 3 == 0) {
+                assert_eq(tree.delete_node(value), expected.erase(value) == 1);
+            } else {
+                assert_eq(tree.insert_node(value), expected.insert(value).second);
+            }
+        }
+
+        assert_eq(tree.size(), expected.size());
+        for (int32_t value = -1; value <= 5000; ++value) {
+            assert_eq(tree.contains(value), expected.contains(value));
+        }
+    }
+
+    // Readers check values that are never deleted are always found, and values that are never
+    // inserted never are, while writers keep inserting and deleting the values in between.
+    {
+        constexpr int32_t STABLE_VALUE_COUNT = 20'000;
+        constexpr size_t  WRITER_COUNT       = 2;
+        constexpr size_t  READER_COUNT       = 4;
+        constexpr size_t  WRITER_OPERATIONS  = 200'000;
+
+        ConcurrentBinaryTree<int32_t> tree;
+        for (int32_t value = 0; value < STABLE_VALUE_COUNT; ++value) {
+            tree.insert_node(4 * value);
+        }
+
+        std::atomic<bool>              writers_done  = false;
+        std::atomic<size_t>            reader_errors = 0;
+        std::vector<std::set<int32_t>> writer_values(WRITER_COUNT);
+        std::vector<std::thread>       threads;
+
+        // Writer w owns the values 4k + 1 + w.
+        for (size_t writer_idx = 0; writer_idx < WRITER_COUNT; ++writer_idx) {
+            threads.emplace_back([&, writer_idx]() {
+                std::mt19937       rng{static_cast<uint32_t>(writer_idx)};
+                std::set<int32_t>& values = writer_values[writer_idx];
+                for (size_t operation = 0; operation < WRITER_OPERATIONS; ++operation) {
+                    int32_t value = 4 * static_cast<int32_t>(rng() % STABLE_VALUE_COUNT) + 1 + static_cast<int32_t>(writer_idx);
+                    if (rng() % 2 == 0) {
+                        assert_eq(tree.delete_node(value), values.erase(value) == 1);
+                    } else {
+                        assert_eq(tree.insert_node(value), values.insert(value).second);
+                    }
+                }
+            });
+        }
+
+        for (size_t reader_idx = 0; reader_idx < READER_COUNT; ++reader_idx) {
+            threads.emplace_back([&, reader_idx]() {
+                std::mt19937 rng{static_cast<uint32_t>(100 + reader_idx)};
+                while (!writers_done.load()) {
+                    int32_t value = 4 * static_cast<int32_t>(rng() % STABLE_VALUE_COUNT);
+                    if (!tree.contains(value) || tree.contains(value + 3) || tree.contains(-1 - value)) {
+                        reader_errors.fetch_add(1);
+                    }
+                }
+            });
+        }
+
+        for (size_t writer_idx = 0; writer_idx < WRITER_COUNT; ++writer_idx) {
+            threads[writer_idx].join();
+        }
+        writers_done.store(true);
+        for (size_t thread_idx = WRITER_COUNT; thread_idx < threads.size(); ++thread_idx) {
+            threads[thread_idx].join();
+        }
+
+        assert_eq(reader_errors.load(), size_t{0});
+
+        size_t expected_size = STABLE_VALUE_COUNT;
+        for (std::set<int32_t> const& values : writer_values) {
+            expected_size += values.size();
+            for (int32_t value : values) {
+                assert_eq(tree.contains(value), true);
+            }
+        }
+        assert_eq(tree.size(), expected_size);
+    }
+
+    report_success();
+    return 0;
+}
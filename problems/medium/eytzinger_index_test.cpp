@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <binary_tree.hpp>
+#include <common.hpp>
+#include <eytzinger_index.hpp>
+#include <random>
+#include <vector>
+
+template <typename T>
+static void assert_matches_lower_bound(EytzingerIndex<T> const& index, std::vector<T> const& sorted_keys, T value) {
+    auto      expected = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), value);
+    T const*  found    = index.lower_bound(value);
+    if (expected == sorted_keys.end()) {
+        assert_eq(found == nullptr, true);
+        assert_eq(index.contains(value), false);
+    } else {
+        assert_eq(found != nullptr, true);
+        assert_eq(*found, *expected);
+        assert_eq(index.contains(value), *expected == value);
+    }
+}
+
+int main() {
+    {
+        EytzingerIndex<int32_t> index{std::vector<int32_t>{}};
+        assert_eq(index.size(), size_t{0});
+        assert_eq(index.lower_bound(0) == nullptr, true);
+        assert_eq(index.contains(0), false);
+    }
+
+    {
+        std::vector<int32_t>    sorted_keys = {-7, -3, 0, 2, 2, 2, 5, 9, 13, 21};
+        EytzingerIndex<int32_t> index{sorted_keys};
+        assert_eq(index.size(), sorted_keys.size());
+
+        assert_eq(*index.lower_bound(-100), -7);
+        assert_eq(*index.lower_bound(-7), -7);
+        assert_eq(*index.lower_bound(-6), -3);
+        assert_eq(*index.lower_bound(1), 2);
+        assert_eq(*index.lower_bound(2), 2);
+        assert_eq(*index.lower_bound(3), 5);
+        assert_eq(*index.lower_bound(21), 21);
+        assert_eq(index.lower_bound(22) == nullptr, true);
+
+        assert_eq(index.contains(9), true);
+        assert_eq(index.contains(10), false);
+    }
+
+    // Every size up to a few complete trees, so that all shapes of the last level are covered.
+    {
+        std::mt19937                           rng{42};
+        std::uniform_int_distribution<int32_t> key_distribution{-1000, 1000};
+
+        for (size_t key_count = 1; key_count <= 130; ++key_count) {
+            std::vector<int32_t> sorted_keys(key_count);
+            for (int32_t& key : sorted_keys) {
+                key = key_distribution(rng);
+            }
+            std::sort(sorted_keys.begin(), sorted_keys.end());
+
+            EytzingerIndex<int32_t> index{sorted_keys};
+            for (int32_t value = -1010; value <= 1010; value += 3) {
+                assert_matches_lower_bound(index, sorted_keys, value);
+            }
+        }
+    }
+
+    // Larger than the caches, with 64-bit keys.
+    {
+        constexpr size_t KEY_COUNT = size_t{1} << 22;
+
+        std::vector<int64_t> sorted_keys(KEY_COUNT);
+        for (size_t idx = 0; idx < KEY_COUNT; ++idx) {
+            sorted_keys[idx] = 3 * static_cast<int64_t>(idx);
+        }
+
+        EytzingerIndex<int64_t>                index{sorted_keys};
+        std::mt19937_64                        rng{7};
+        std::uniform_int_distribution<int64_t> value_distribution{-5, 3 * static_cast<int64_t>(KEY_COUNT) + 5};
+        for (size_t query = 0; query < 100'000; ++query) {
+            assert_matches_lower_bound(index, sorted_keys, value_distribution(rng));
+        }
+    }
+
+    // Built from a tree.
+    {
+        BinaryTree<int32_t> tree{50, 100};
+        std::vector<int32_t> sorted_keys = {50};
+        for (int32_t key = 0; key < 100; key += 7) {
+            tree.insert_node(key);
+            sorted_keys.push_back(key);
+        }
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+        sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()), sorted_keys.end());
+
+        EytzingerIndex<int32_t> index{tree};
+        assert_eq(index.size(), sorted_keys.size());
+        for (int32_t value = -5; value <= 105; ++value) {
+            assert_matches_lower_bound(index, sorted_keys, value);
+        }
+    }
+
+    report_success();
+    return 0;
+}
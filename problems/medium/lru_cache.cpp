@@ -31,9 +31,25 @@
 // - At most 2 * 10^5 calls will be made to get and put.
 // ------------------------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <common.hpp>
+#include <functional>
+#include <limits>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 struct BadLRUCache {
     using Key   = int32_t;
@@ -90,112 +106,406 @@ struct BadLRUCache {
     }
 };
 
-// @NOTE: Too many pointer dereferences for my taste. Slow, computer no go vroom vroom. Me no likey :(
+enum struct EvictionPolicy {
+    // Evicts the least recently used key, at the cost of relinking the recency list on every hit.
+    LEAST_RECENTLY_USED,
+    // Approximates LRU with a single reference bit per entry, set by hits. Evictions sweep a hand
+    // over the entries, clearing the bits it passes until it finds an entry without it.
+    CLOCK,
+};
+
+// Cache for any hashable key, whose memory only depends on its capacity.
+//
+// The entries are stored densely in an array, allocated once, and the recency list links them by
+// their 32-bit index in it. Keys are found through an open addressing index with linear probing,
+// whose slots hold the index of an entry along with the upper bits of the hash of its key: probing
+// compares those bits first, so that it rarely touches the entries themselves, and slots are removed
+// by shifting the following ones back rather than leaving tombstones.
+//
+// With the CLOCK policy, hits only write the reference bit of the entry, which is atomic: any
+// number of threads may get keys at once, as long as no thread puts keys meanwhile.
+template <typename K, typename V, typename Hash = std::hash<K>, EvictionPolicy POLICY = EvictionPolicy::LEAST_RECENTLY_USED>
 struct LRUCache {
-    using Key   = int32_t;
-    using Value = int32_t;
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+
+    static constexpr uint32_t INVALID_ENTRY = std::numeric_limits<uint32_t>::max();
 
-    static constexpr Key   MAX_KEY       = 10'000;
-    static constexpr Value INVALID_VALUE = -1;
+    static constexpr bool IS_CLOCK = POLICY == EvictionPolicy::CLOCK;
+
+    struct Entry {
+        K        key;
+        V        value;
+        // Unused by the CLOCK policy.
+        uint32_t newer_entry_idx = INVALID_ENTRY;
+        uint32_t older_entry_idx = INVALID_ENTRY;
+    };
 
-    struct CacheNode {
-        CacheNode* next_node  = nullptr;
-        CacheNode* prior_node = nullptr;
-        Value      value      = INVALID_VALUE;
+    struct Slot {
+        uint32_t entry_idx = INVALID_ENTRY;
+        // Upper 32 bits of the hash of the key, the first of which are the home slot of the key.
+        uint32_t hash_tag = 0;
     };
 
-    CacheNode cache[MAX_KEY + 1];
-    size_t    cache_capacity = 0;
-    size_t    cache_size     = 0;
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
 
-    // The start endpoint next_node is the actual first node (lowest priority) of the cache,
-    // and the prior_node is end endpoint.
-    //
-    // @NOTE: This is not a valid node of the cache.
-    CacheNode start = {};
+    std::vector<Entry> entries;
 
-    // The end endpoint next_node is start, and the prior_node is the actual last
-    // node (highest priority) of the cache, and the prior_node is start endpoint.
-    //
-    // @NOTE: This is not a valid node of the cache.
-    CacheNode end = {};
+    // At least twice as many slots as the capacity, a power of two.
+    std::vector<Slot> slots;
+    uint32_t          slot_bits = 0;
 
-    LRUCache(size_t capacity) {
+    size_t cache_capacity = 0;
+
+    uint32_t most_recent_entry_idx  = INVALID_ENTRY;
+    uint32_t least_recent_entry_idx = INVALID_ENTRY;
+
+    // Reference bit of each entry and the entry the hand points at, only used by the CLOCK policy.
+    std::unique_ptr<std::atomic<uint8_t>[]> reference_bits;
+    uint32_t                                clock_hand_idx = 0;
+
+    Hash hash;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    explicit LRUCache(size_t capacity) {
+        assert(capacity > 0 && capacity < INVALID_ENTRY / 2);
         this->cache_capacity = capacity;
+        this->entries.reserve(capacity);
 
-        this->start.next_node = &this->end;
-        this->end.prior_node  = &this->start;
+        this->slot_bits = static_cast<uint32_t>(std::bit_width(2 * capacity - 1));
+        this->slots.resize(size_t{1} << this->slot_bits);
+
+        if constexpr (IS_CLOCK) {
+            this->reference_bits = std::make_unique<std::atomic<uint8_t>[]>(capacity);
+        }
     }
 
-    void delete_node(CacheNode* node) {
-        // Connect the neighbours of the node.
-        node->prior_node->next_node = node->next_node;
-        node->next_node->prior_node = node->prior_node;
+    size_t size() const {
+        return this->entries.size();
+    }
 
-        // Reset the node state.
-        node->next_node  = nullptr;
-        node->prior_node = nullptr;
+    // Returns the value of the key, or nullptr if it isn't cached.
+    V* get(K const& key) {
+        uint32_t hash_tag  = this->impl_hash_tag(key);
+        size_t   slot_idx  = this->impl_find_slot(key, hash_tag);
+        uint32_t entry_idx = this->slots[slot_idx].entry_idx;
+        if (entry_idx == INVALID_ENTRY) {
+            return nullptr;
+        }
 
-        --this->cache_size;
+        this->impl_touch(entry_idx);
+        return &this->entries[entry_idx].value;
     }
 
-    void add_node(CacheNode* node) {
-        // Put the current last node before the given node.
-        CacheNode* previous_last_node = this->end.prior_node;
-        previous_last_node->next_node = node;
-        node->prior_node              = previous_last_node;
+    void put(K const& key, V value) {
+        uint32_t hash_tag  = this->impl_hash_tag(key);
+        size_t   slot_idx  = this->impl_find_slot(key, hash_tag);
+        uint32_t entry_idx = this->slots[slot_idx].entry_idx;
+        if (entry_idx != INVALID_ENTRY) {
+            this->entries[entry_idx].value = std::move(value);
+            this->impl_touch(entry_idx);
+            return;
+        }
 
-        // Make node the current last node.
-        node->next_node      = &this->end;
-        this->end.prior_node = node;
+        if (this->entries.size() < this->cache_capacity) {
+            entry_idx = static_cast<uint32_t>(this->entries.size());
+            this->entries.push_back(Entry{.key = key, .value = std::move(value)});
+        } else {
+            entry_idx            = this->impl_evict();
+            K const& evicted_key = this->entries[entry_idx].key;
+            this->impl_erase_slot(this->impl_find_slot(evicted_key, this->impl_hash_tag(evicted_key)));
+            this->entries[entry_idx].key   = key;
+            this->entries[entry_idx].value = std::move(value);
+
+            // The erased slot may have shifted the one found for the key.
+            slot_idx = this->impl_find_slot(key, hash_tag);
+        }
 
-        ++this->cache_size;
+        this->slots[slot_idx] = Slot{.entry_idx = entry_idx, .hash_tag = hash_tag};
+        if constexpr (!IS_CLOCK) {
+            this->impl_link_most_recent(entry_idx);
+        }
     }
 
-    Value get(Key key) {
-        assert(key <= MAX_KEY);
+    // -----------------------------------------------------------------------------
+    // Implementation details.
+    // -----------------------------------------------------------------------------
 
-        CacheNode* node = &this->cache[key];
+    uint32_t impl_hash_tag(K const& key) const {
+        // Standard hashes of integers are usually the identity, mix the bits so that the upper ones
+        // depend on all of them.
+        uint64_t mixed = static_cast<uint64_t>(this->hash(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(mixed >> 32);
+    }
 
-        Value value;
-        if (node->prior_node == nullptr) {
-            // This node was never initialized or got deleted.
-            value = INVALID_VALUE;
-        } else {
-            value = node->value;
+    size_t impl_home_slot(uint32_t hash_tag) const {
+        return static_cast<size_t>(hash_tag >> (32 - this->slot_bits));
+    }
 
-            // Promote the node to highest priority.
-            this->delete_node(node);
-            this->add_node(node);
+    // Returns the slot of the key, or the empty slot where it would be inserted.
+    size_t impl_find_slot(K const& key, uint32_t hash_tag) const {
+        size_t slot_mask = this->slots.size() - 1;
+        size_t slot_idx  = this->impl_home_slot(hash_tag);
+        while (true) {
+            Slot const& slot = this->slots[slot_idx];
+            if (slot.entry_idx == INVALID_ENTRY || (slot.hash_tag == hash_tag && this->entries[slot.entry_idx].key == key)) {
+                return slot_idx;
+            }
+            slot_idx = (slot_idx + 1) & slot_mask;
         }
+    }
 
-        return value;
+    // Empties the slot, moving back the following slots of the probe sequence that may take its
+    // place, so that lookups never have to skip removed slots.
+    void impl_erase_slot(size_t slot_idx) {
+        size_t slot_mask = this->slots.size() - 1;
+        size_t hole_idx  = slot_idx;
+        size_t next_idx  = (slot_idx + 1) & slot_mask;
+        while (this->slots[next_idx].entry_idx != INVALID_ENTRY) {
+            size_t home_idx = this->impl_home_slot(this->slots[next_idx].hash_tag);
+
+            // The slot can move back to the hole if the hole isn't before its home slot.
+            if (((next_idx - home_idx) & slot_mask) >= ((next_idx - hole_idx) & slot_mask)) {
+                this->slots[hole_idx] = this->slots[next_idx];
+                hole_idx              = next_idx;
+            }
+            next_idx = (next_idx + 1) & slot_mask;
+        }
+        this->slots[hole_idx] = Slot{};
     }
 
-    void put(Key key, Value value) {
-        assert(key <= MAX_KEY);
+    void impl_touch(uint32_t entry_idx) {
+        if constexpr (IS_CLOCK) {
+            // Skip the write when the bit is set already, so that hits on hot entries leave their
+            // cache line shared between the cores reading it.
+            if (this->reference_bits[entry_idx].load(std::memory_order_relaxed) == 0) {
+                this->reference_bits[entry_idx].store(1, std::memory_order_relaxed);
+            }
+        } else {
+            this->impl_unlink(entry_idx);
+            this->impl_link_most_recent(entry_idx);
+        }
+    }
 
-        CacheNode* node = &this->cache[key];
+    // Returns the entry to reuse for a new key, whose slot is still to be erased. New keys start
+    // without their reference bit, so that keys never hit again are the first to go.
+    uint32_t impl_evict() {
+        if constexpr (IS_CLOCK) {
+            while (this->reference_bits[this->clock_hand_idx].exchange(0, std::memory_order_relaxed) != 0) {
+                this->clock_hand_idx = (this->clock_hand_idx + 1 == this->cache_capacity) ? 0 : this->clock_hand_idx + 1;
+            }
+            uint32_t entry_idx   = this->clock_hand_idx;
+            this->clock_hand_idx = (entry_idx + 1 == this->cache_capacity) ? 0 : entry_idx + 1;
+            return entry_idx;
+        } else {
+            uint32_t entry_idx = this->least_recent_entry_idx;
+            this->impl_unlink(entry_idx);
+            return entry_idx;
+        }
+    }
 
-        if (node->prior_node != nullptr) {
-            // The node is already initialized, update its value.
-            node->value = value;
+    void impl_unlink(uint32_t entry_idx) {
+        Entry& entry = this->entries[entry_idx];
+        if (entry.newer_entry_idx != INVALID_ENTRY) {
+            this->entries[entry.newer_entry_idx].older_entry_idx = entry.older_entry_idx;
+        } else {
+            this->most_recent_entry_idx = entry.older_entry_idx;
+        }
+        if (entry.older_entry_idx != INVALID_ENTRY) {
+            this->entries[entry.older_entry_idx].newer_entry_idx = entry.newer_entry_idx;
+        } else {
+            this->least_recent_entry_idx = entry.newer_entry_idx;
+        }
+        entry.newer_entry_idx = INVALID_ENTRY;
+        entry.older_entry_idx = INVALID_ENTRY;
+    }
 
-            // Put the node as the last one.
-            this->delete_node(node);
-            this->add_node(node);
+    void impl_link_most_recent(uint32_t entry_idx) {
+        Entry& entry          = this->entries[entry_idx];
+        entry.older_entry_idx = this->most_recent_entry_idx;
+        if (this->most_recent_entry_idx != INVALID_ENTRY) {
+            this->entries[this->most_recent_entry_idx].newer_entry_idx = entry_idx;
         } else {
-            if (this->cache_size == this->cache_capacity) {
-                // Evict the first node.
-                this->delete_node(this->start.next_node);
-            }
+            this->least_recent_entry_idx = entry_idx;
+        }
+        this->most_recent_entry_idx = entry_idx;
+    }
+};
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+using ClockCache = LRUCache<K, V, Hash, EvictionPolicy::CLOCK>;
+
+// Thread-safe cache made of independent LRU caches, the shards, each with its own lock. Keys are
+// spread over the shards by their hash, so that threads touching different keys rarely wait for one
+// another, while each shard still evicts its own least recently used key.
+//
+// Shards start at a cache line boundary and are padded to a whole number of cache lines, so that
+// locking one shard never invalidates the cache line of another.
+//
+// With the CLOCK policy, gets only take a shared lock of their shard, so they don't wait for one
+// another but only for puts.
+template <typename K, typename V, typename Hash = std::hash<K>, EvictionPolicy POLICY = EvictionPolicy::LEAST_RECENTLY_USED>
+struct ShardedLRUCache {
+    // -----------------------------------------------------------------------------
+    // Static methods, associated structs, and constants.
+    // -----------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4324)  // Structure was padded due to alignment specifier.
+#endif
+    using Mutex = std::conditional_t<POLICY == EvictionPolicy::CLOCK, std::shared_mutex, std::mutex>;
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        Mutex                        mutex;
+        LRUCache<K, V, Hash, POLICY> cache;
+
+        explicit Shard(size_t capacity) : cache{capacity} {}
+    };
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+    // A few shards per hardware thread, so that concurrent accesses rarely hit the same shard.
+    static size_t default_shard_count() {
+        return 4 * size_t{max_value(std::thread::hardware_concurrency(), 1u)};
+    }
+
+    // Splits the capacity as evenly as possible over the shards, each getting at least one entry.
+    static std::vector<size_t> even_split(size_t capacity, size_t shard_count) {
+        assert(capacity > 0 && shard_count > 0);
+        shard_count = min_value(shard_count, capacity);
+
+        std::vector<size_t> shard_capacities(shard_count, capacity / shard_count);
+        for (size_t shard_idx = 0; shard_idx < capacity % shard_count; ++shard_idx) {
+            shard_capacities[shard_idx] += 1;
+        }
+        return shard_capacities;
+    }
+
+    // -----------------------------------------------------------------------------
+    // Members.
+    // -----------------------------------------------------------------------------
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    size_t cache_capacity = 0;
+
+    Hash hash;
+
+    // -----------------------------------------------------------------------------
+    // Methods.
+    // -----------------------------------------------------------------------------
+
+    explicit ShardedLRUCache(size_t capacity, size_t shard_count = default_shard_count())
+        : ShardedLRUCache{even_split(capacity, shard_count)} {}
+
+    // Makes a shard of each capacity: keys are spread evenly over the shards whatever their
+    // capacity, so uneven capacities only make sense with hashes known to be uneven.
+    explicit ShardedLRUCache(std::span<size_t const> shard_capacities) {
+        assert(!shard_capacities.empty());
+        this->shards.reserve(shard_capacities.size());
+        for (size_t shard_capacity : shard_capacities) {
+            this->shards.push_back(std::make_unique<Shard>(shard_capacity));
+            this->cache_capacity += shard_capacity;
+        }
+    }
+
+    ShardedLRUCache(std::vector<size_t> const& shard_capacities)
+        : ShardedLRUCache{std::span<size_t const>{shard_capacities}} {}
+
+    size_t capacity() const {
+        return this->cache_capacity;
+    }
 
-            node->value = value;
-            this->add_node(node);
+    size_t size() const {
+        size_t total_size = 0;
+        for (std::unique_ptr<Shard> const& shard : this->shards) {
+            std::lock_guard<Mutex> lock{shard->mutex};
+            total_size += shard->cache.size();
         }
+        return total_size;
+    }
+
+    // Returns a copy of the value of the key, since the value may be evicted as soon as the lock
+    // of its shard is released.
+    std::optional<V> get(K const& key) {
+        Shard& shard = this->impl_shard(key);
+        if constexpr (POLICY == EvictionPolicy::CLOCK) {
+            std::shared_lock<Mutex> lock{shard.mutex};
+            V*                      value = shard.cache.get(key);
+            return (value != nullptr) ? std::optional<V>{*value} : std::nullopt;
+        } else {
+            std::lock_guard<Mutex> lock{shard.mutex};
+            V*                     value = shard.cache.get(key);
+            return (value != nullptr) ? std::optional<V>{*value} : std::nullopt;
+        }
+    }
+
+    void put(K const& key, V value) {
+        Shard&                 shard = this->impl_shard(key);
+        std::lock_guard<Mutex> lock{shard.mutex};
+        shard.cache.put(key, std::move(value));
+    }
+
+    // -----------------------------------------------------------------------------
+    // Implementation details.
+    // -----------------------------------------------------------------------------
+
+    Shard& impl_shard(K const& key) {
+        // The shards use the upper bits of the hash mixed by another constant, so that the keys of
+        // a shard still spread over all the slots of its index.
+        uint64_t mixed      = static_cast<uint64_t>(this->hash(key)) * 0xC2B2AE3D27D4EB4Full;
+        uint64_t upper_bits = mixed >> 32;
+        return *this->shards[static_cast<size_t>((upper_bits * this->shards.size()) >> 32)];
     }
 };
 
+// Concurrent gets and puts of skewed keys, each key always mapping to the same value.
+template <EvictionPolicy POLICY>
+static void test_concurrent_sharded_cache() {
+    constexpr size_t   CAPACITY              = 512;
+    constexpr size_t   THREAD_COUNT          = 4;
+    constexpr uint64_t OPERATIONS_PER_THREAD = 50'000;
+
+    ShardedLRUCache<uint64_t, uint64_t, std::hash<uint64_t>, POLICY> sharded{CAPACITY, 8};
+
+    std::vector<std::thread> threads;
+    std::vector<uint64_t>    hit_counts(THREAD_COUNT, 0);
+    for (size_t thread_idx = 0; thread_idx < THREAD_COUNT; ++thread_idx) {
+        threads.emplace_back([&sharded, &hit_counts, thread_idx]() {
+            std::mt19937_64 rng{thread_idx};
+            uint64_t        hit_count = 0;
+            for (uint64_t operation = 0; operation < OPERATIONS_PER_THREAD; ++operation) {
+                // Small keys are far more frequent than large ones.
+                uint64_t key = rng() % (rng() % 4096 + 1);
+                if (std::optional<uint64_t> value = sharded.get(key)) {
+                    assert_eq(*value, 7 * key);
+                    hit_count += 1;
+                } else {
+                    sharded.put(key, 7 * key);
+                }
+            }
+            hit_counts[thread_idx] = hit_count;
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    assert_eq(sharded.size() <= CAPACITY, true);
+    for (auto const& shard : sharded.shards) {
+        assert_eq(shard->cache.size() <= shard->cache.cache_capacity, true);
+    }
+    assert_eq(hit_counts[0] > 0, true);
+}
+
 int main() {
     // Bad LRU test 1.
     {
@@ -227,30 +537,228 @@ int main() {
 
     // Test 1.
     {
-        LRUCache lru{2};
-
-        lru.put(1, 10);             // Cache: {1 = 10}
-        assert_eq(lru.get(1), 10);  // Cache: {1 = 10}
-        lru.put(2, 20);             // Cache: {1 = 10, 2 = 20}
-        lru.put(3, 30);             // Cache: {2 = 20, 3 = 30}, key 1 was evicted
-        assert_eq(lru.get(2), 20);  // Cache: {3 = 30, 2 = 20}
-        assert_eq(lru.get(1), -1);  // Cache: {3 = 30, 2 = 20}
-        lru.put(4, 40);             // Cache: {2 = 20, 4 = 40}, key 3 was evicted
-        assert_eq(lru.get(3), -1);  // Cache: {2 = 20, 4 = 40}
+        LRUCache<int32_t, int32_t> lru{2};
+
+        lru.put(1, 10);                          // Cache: {1 = 10}
+        assert_eq(*lru.get(1), 10);              // Cache: {1 = 10}
+        lru.put(2, 20);                          // Cache: {1 = 10, 2 = 20}
+        lru.put(3, 30);                          // Cache: {2 = 20, 3 = 30}, key 1 was evicted
+        assert_eq(*lru.get(2), 20);              // Cache: {3 = 30, 2 = 20}
+        assert_eq(lru.get(1) == nullptr, true);  // Cache: {3 = 30, 2 = 20}
+        lru.put(4, 40);                          // Cache: {2 = 20, 4 = 40}, key 3 was evicted
+        assert_eq(lru.get(3) == nullptr, true);  // Cache: {2 = 20, 4 = 40}
     }
 
     // Test 2.
     {
-        LRUCache lru{2};
+        LRUCache<int32_t, int32_t> lru{2};
+
+        assert_eq(lru.get(2) == nullptr, true);  // Cache: {}
+        lru.put(2, 6);                           // Cache: {2 = 6}
+        assert_eq(*lru.get(2), 6);               // Cache: {2 = 6}
+        assert_eq(lru.get(1) == nullptr, true);  // Cache: {2 = 6}
+        lru.put(1, 5);                           // Cache: {2 = 6, 1 = 5}
+        lru.put(1, 2);                           // Cache: {2 = 6, 1 = 2}
+        assert_eq(*lru.get(1), 2);               // Cache: {2 = 6, 1 = 2}
+        assert_eq(*lru.get(2), 6);               // Cache: {2 = 6, 1 = 2}
+    }
 
-        assert_eq(lru.get(2), -1);  // Cache: {}
-        lru.put(2, 6);              // Cache: {2 = 6}
-        assert_eq(lru.get(2), 6);   // Cache: {2 = 6}
-        assert_eq(lru.get(1), -1);  // Cache: {2 = 6}
-        lru.put(1, 5);              // Cache: {2 = 6, 1 = 5}
-        lru.put(1, 2);              // Cache: {2 = 6, 1 = 2}
-        assert_eq(lru.get(1), 2);   // Cache: {2 = 6, 1 = 2}
-        assert_eq(lru.get(2), 6);   // Cache: {2 = 6, 1 = 2}
+    // String and 64-bit keys.
+    {
+        LRUCache<std::string, std::string> lru{2};
+
+        lru.put("one", "1");
+        lru.put("two", "2");
+        assert_eq(*lru.get("one"), std::string{"1"});
+        lru.put("three", "3");  // Evicts "two".
+        assert_eq(lru.get("two") == nullptr, true);
+        assert_eq(*lru.get("three"), std::string{"3"});
+
+        LRUCache<uint64_t, int32_t> wide{3};
+        for (uint64_t key : {uint64_t{1} << 40, uint64_t{1} << 50, uint64_t{1} << 60, uint64_t{1} << 40}) {
+            wide.put(key, static_cast<int32_t>(key >> 40));
+        }
+        assert_eq(wide.size(), size_t{3});
+        assert_eq(*wide.get(uint64_t{1} << 60), int32_t{1} << 20);
+    }
+
+    // Memory only depends on the capacity, however spread the keys are.
+    {
+        LRUCache<uint64_t, uint64_t> lru{1000};
+        size_t                       entry_capacity = lru.entries.capacity();
+        size_t                       slot_count     = lru.slots.size();
+
+        std::mt19937_64 rng{13};
+        for (size_t operation = 0; operation < 100'000; ++operation) {
+            uint64_t key = rng();
+            lru.put(key, operation);
+            assert_eq(*lru.get(key), operation);
+        }
+        assert_eq(lru.size(), size_t{1000});
+        assert_eq(lru.entries.capacity(), entry_capacity);
+        assert_eq(lru.slots.size(), slot_count);
+        assert_eq(slot_count, size_t{2048});
+    }
+
+    // Random operations against the node-based cache, with keys clustering in the index.
+    {
+        constexpr size_t CAPACITY = 100;
+
+        BadLRUCache                expected{CAPACITY};
+        LRUCache<int32_t, int32_t> lru{CAPACITY};
+
+        std::mt19937 rng{8};
+        for (int32_t operation = 0; operation < 200'000; ++operation) {
+            int32_t key = static_cast<int32_t>(rng() % 300) * 1024;
+            if (rng() % 2 == 0) {
+                lru.put(key, operation);
+                expected.put(key, operation);
+            } else {
+                int32_t* value = lru.get(key);
+                assert_eq((value != nullptr) ? *value : -1, expected.get(key));
+            }
+        }
+        assert_eq(lru.size(), CAPACITY);
+    }
+
+    // Sharded cache split over its shards.
+    {
+        ShardedLRUCache<int32_t, int32_t> sharded{10, 4};
+        assert_eq(sharded.shards.size(), size_t{4});
+        assert_eq(sharded.capacity(), size_t{10});
+        assert_eq(sharded.shards[0]->cache.cache_capacity, size_t{3});
+        assert_eq(sharded.shards[3]->cache.cache_capacity, size_t{2});
+
+        // Never more shards than entries.
+        assert_eq((ShardedLRUCache<int32_t, int32_t>{3, 8}).shards.size(), size_t{3});
+
+        ShardedLRUCache<int32_t, int32_t> uneven{std::vector<size_t>{1, 2, 3}};
+        assert_eq(uneven.capacity(), size_t{6});
+        assert_eq(uneven.get(1).has_value(), false);
+        uneven.put(1, 10);
+        assert_eq(*uneven.get(1), 10);
+    }
+
+    // With a single shard, the sharded cache evicts exactly like the LRU cache.
+    {
+        constexpr size_t CAPACITY = 64;
+
+        BadLRUCache                       expected{CAPACITY};
+        ShardedLRUCache<int32_t, int32_t> sharded{CAPACITY, 1};
+
+        std::mt19937 rng{21};
+        for (int32_t operation = 0; operation < 100'000; ++operation) {
+            int32_t key = static_cast<int32_t>(rng() % 200);
+            if (rng() % 2 == 0) {
+                sharded.put(key, operation);
+                expected.put(key, operation);
+            } else {
+                assert_eq(sharded.get(key).value_or(-1), expected.get(key));
+            }
+        }
+    }
+
+    test_concurrent_sharded_cache<EvictionPolicy::LEAST_RECENTLY_USED>();
+    test_concurrent_sharded_cache<EvictionPolicy::CLOCK>();
+
+    // CLOCK spares the entries hit since the last pass of the hand.
+    {
+        ClockCache<int32_t, int32_t> clock{2};
+
+        clock.put(1, 10);
+        clock.put(2, 20);
+        assert_eq(*clock.get(1), 10);
+        clock.put(3, 30);  // Clears the bit of key 1 and evicts key 2.
+        assert_eq(clock.get(2) == nullptr, true);
+        assert_eq(*clock.get(1), 10);
+        assert_eq(*clock.get(3), 30);
+        clock.put(4, 40);  // Both bits were set: clears them and evicts key 1, where the hand was.
+        assert_eq(clock.get(1) == nullptr, true);
+        assert_eq(*clock.get(3), 30);
+        assert_eq(*clock.get(4), 40);
+    }
+
+    // Random operations against a CLOCK with a linear search, with keys clustering in the index.
+    {
+        constexpr size_t CAPACITY = 100;
+
+        std::vector<std::pair<int32_t, int32_t>> expected_entries;
+        std::vector<bool>                        expected_reference_bits(CAPACITY, false);
+        size_t                                   expected_hand_idx = 0;
+
+        ClockCache<int32_t, int32_t> clock{CAPACITY};
+
+        std::mt19937 rng{34};
+        for (int32_t operation = 0; operation < 200'000; ++operation) {
+            int32_t key = static_cast<int32_t>(rng() % 300) * 1024;
+
+            auto expected_entry = std::find_if(expected_entries.begin(), expected_entries.end(), [key](auto const& entry) {
+                return entry.first == key;
+            });
+            bool   is_cached   = expected_entry != expected_entries.end();
+            size_t expected_idx = static_cast<size_t>(expected_entry - expected_entries.begin());
+
+            if (rng() % 2 == 0) {
+                clock.put(key, operation);
+                if (is_cached) {
+                    expected_entry->second                = operation;
+                    expected_reference_bits[expected_idx] = true;
+                } else if (expected_entries.size() < CAPACITY) {
+                    expected_entries.emplace_back(key, operation);
+                } else {
+                    while (expected_reference_bits[expected_hand_idx]) {
+                        expected_reference_bits[expected_hand_idx] = false;
+                        expected_hand_idx                          = (expected_hand_idx + 1) % CAPACITY;
+                    }
+                    expected_entries[expected_hand_idx] = {key, operation};
+                    expected_hand_idx                   = (expected_hand_idx + 1) % CAPACITY;
+                }
+            } else {
+                int32_t* value = clock.get(key);
+                assert_eq(value != nullptr, is_cached);
+                if (is_cached) {
+                    assert_eq(*value, expected_entry->second);
+                    expected_reference_bits[expected_idx] = true;
+                }
+            }
+        }
+        assert_eq(clock.size(), CAPACITY);
+    }
+
+    // Under a Zipfian load, CLOCK hits about as often as LRU.
+    {
+        constexpr size_t  CAPACITY  = 1000;
+        constexpr int32_t KEY_COUNT = 20'000;
+
+        std::vector<double> key_weights(KEY_COUNT);
+        for (int32_t rank = 0; rank < KEY_COUNT; ++rank) {
+            key_weights[static_cast<size_t>(rank)] = 1.0 / static_cast<double>(rank + 1);
+        }
+        std::discrete_distribution<int32_t> zipf{key_weights.begin(), key_weights.end()};
+
+        LRUCache<int32_t, int32_t>   lru{CAPACITY};
+        ClockCache<int32_t, int32_t> clock{CAPACITY};
+        size_t                       lru_hit_count   = 0;
+        size_t                       clock_hit_count = 0;
+
+        std::mt19937 rng{55};
+        for (int32_t operation = 0; operation < 200'000; ++operation) {
+            int32_t key = zipf(rng);
+            if (lru.get(key) != nullptr) {
+                lru_hit_count += 1;
+            } else {
+                lru.put(key, key);
+            }
+            if (clock.get(key) != nullptr) {
+                clock_hit_count += 1;
+            } else {
+                clock.put(key, key);
+            }
+        }
+
+        // Within two percent of the accesses.
+        assert_eq(lru_hit_count > 0, true);
+        assert_eq(clock_hit_count + 4'000 >= lru_hit_count, true);
     }
 
     report_success();
@@ -0,0 +1,149 @@
+#include <binary_tree.hpp>
+#include <bit>
+#include <common.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <mapped_binary_tree.hpp>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+int main() {
+    std::string tree_path = (std::filesystem::temp_directory_path() / "mapped_binary_tree_test.bin").string();
+
+    // Lookups on the mapped tree agree with the saved one, free slots included.
+    {
+        BinaryTree<int32_t> tree{std::span<int32_t const>{}};
+        std::set<int32_t>   expected;
+
+        std::mt19937 rng{3};
+        for (size_t operation = 0; operation < 20'000; ++operation) {
+            int32_t value = static_cast<int32_t>(rng() % 10'000);
+            if (rng() % 4 == 0) {
+                tree.delete_node(value);
+                expected.erase(value);
+            } else {
+                tree.insert_node(value);
+                expected.insert(value);
+            }
+        }
+        assert_eq(MappedBinaryTree<int32_t>::save(tree, tree_path.c_str()), true);
+
+        MappedBinaryTree<int32_t> mapped;
+        assert_eq(mapped.open(tree_path.c_str()), true);
+        assert_eq(mapped.size(), expected.size());
+        assert_eq(reinterpret_cast<uintptr_t>(mapped.memory) % CACHE_LINE_SIZE, uintptr_t{0});
+
+        for (int32_t value = -1; value <= 10'001; ++value) {
+            assert_eq(mapped.find_node(value), tree.find_node(value));
+            assert_eq(mapped.contains(value), expected.contains(value));
+            assert_eq(mapped.rank(value), tree.rank(value));
+
+            auto           tree_lower_bound   = tree.lower_bound(value);
+            int32_t const* mapped_lower_bound = mapped.lower_bound(value);
+            if (tree_lower_bound == tree.end()) {
+                assert_eq(mapped_lower_bound == nullptr, true);
+            } else {
+                assert_eq(*mapped_lower_bound, *tree_lower_bound);
+            }
+        }
+    }
+
+    // Maps keep their values.
+    {
+        std::vector<int64_t> keys   = {40, 10, 30, 20};
+        std::vector<double>  values = {4.0, 1.0, 3.0, 2.0};
+
+        using MappedMap = MappedBinaryTree<int64_t, double>;
+
+        BinaryTree<int64_t, double> tree{keys, values};
+        assert_eq(MappedMap::save(tree, tree_path.c_str()), true);
+
+        MappedMap mapped;
+        assert_eq(mapped.open(tree_path.c_str()), true);
+        assert_eq(*mapped.find_value(30), 3.0);
+        assert_eq(*mapped.find_value(10), 1.0);
+        assert_eq(mapped.find_value(35) == nullptr, true);
+        assert_eq(*mapped.lower_bound(35), int64_t{40});
+
+        // The layout of the nodes of another type differs.
+        MappedBinaryTree<int32_t, double> mismatched;
+        assert_eq(mismatched.open(tree_path.c_str()), false);
+        MappedBinaryTree<int64_t> without_values;
+        assert_eq(without_values.open(tree_path.c_str()), false);
+    }
+
+    // Empty trees round trip too.
+    {
+        BinaryTree<int32_t> empty{std::span<int32_t const>{}};
+        assert_eq(MappedBinaryTree<int32_t>::save(empty, tree_path.c_str()), true);
+
+        MappedBinaryTree<int32_t> mapped;
+        assert_eq(mapped.open(tree_path.c_str()), true);
+        assert_eq(mapped.size(), size_t{0});
+        assert_eq(mapped.contains(0), false);
+        assert_eq(mapped.lower_bound(0) == nullptr, true);
+    }
+
+    // Files of other versions, and truncated ones, are rejected.
+    {
+        std::vector<int32_t> values(1000);
+        for (size_t idx = 0; idx < values.size(); ++idx) {
+            values[idx] = static_cast<int32_t>(idx);
+        }
+        BinaryTree<int32_t> tree{values};
+        assert_eq(MappedBinaryTree<int32_t>::save(tree, tree_path.c_str()), true);
+
+        {
+            std::fstream file{tree_path, std::ios::binary | std::ios::in | std::ios::out};
+            uint32_t     other_version = MappedBinaryTree<int32_t>::FORMAT_VERSION + 1;
+            file.seekp(offsetof(MappedBinaryTree<int32_t>::FileHeader, format_version));
+            file.write(reinterpret_cast<char const*>(&other_version), sizeof(other_version));
+        }
+        MappedBinaryTree<int32_t> mapped;
+        assert_eq(mapped.open(tree_path.c_str()), false);
+
+        assert_eq(MappedBinaryTree<int32_t>::save(tree, tree_path.c_str()), true);
+        std::filesystem::resize_file(tree_path, std::filesystem::file_size(tree_path) / 2);
+        assert_eq(mapped.open(tree_path.c_str()), false);
+
+        std::filesystem::remove(tree_path);
+        assert_eq(mapped.open(tree_path.c_str()), false);
+    }
+
+    // Slot counts and offsets pointing past the end of the file are rejected, even when the end of
+    // the nodes would wrap around.
+    {
+        using Mapped = MappedBinaryTree<int32_t>;
+        using Header = Mapped::FileHeader;
+
+        BinaryTree<int32_t> tree{std::span<int32_t const>{}};
+        tree.insert_node(1);
+
+        auto corrupt_header = [&tree_path](size_t field_offset, uint64_t field_value) {
+            std::fstream file{tree_path, std::ios::binary | std::ios::in | std::ios::out};
+            file.seekp(static_cast<std::streamoff>(field_offset));
+            file.write(reinterpret_cast<char const*>(&field_value), sizeof(field_value));
+        };
+
+        // The nodes of the wrapping slot count take a multiple of 2^64 bytes.
+        uint64_t wrapping_slot_count = uint64_t{1} << (64 - std::countr_zero(sizeof(Mapped::Node)));
+        assert_eq(wrapping_slot_count * sizeof(Mapped::Node), uint64_t{0});
+
+        Mapped mapped;
+        assert_eq(Mapped::save(tree, tree_path.c_str()), true);
+        corrupt_header(offsetof(Header, slot_count), wrapping_slot_count);
+        assert_eq(mapped.open(tree_path.c_str()), false);
+
+        assert_eq(Mapped::save(tree, tree_path.c_str()), true);
+        corrupt_header(offsetof(Header, nodes_offset), uint64_t{1} << 40);
+        assert_eq(mapped.open(tree_path.c_str()), false);
+
+        std::filesystem::remove(tree_path);
+    }
+
+    report_success();
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <atomic>
+#include <common.hpp>
+#include <functional>
+#include <persistent_binary_tree.hpp>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+template <typename T>
+static std::vector<T> snapshot_values(typename PersistentBinaryTree<T>::Snapshot const& snapshot) {
+    std::vector<T> values;
+    snapshot.for_each([&](T const& value) { values.push_back(value); });
+    return values;
+}
+
+int main() {
+    // Snapshots keep seeing the version they were taken from.
+    {
+        PersistentBinaryTree<int32_t> tree;
+        for (int32_t value : {5, 2, 8, 1, 9}) {
+            assert_eq(tree.insert_node(value), true);
+        }
+        assert_eq(tree.insert_node(5), false);
+
+        auto before = tree.acquire_snapshot();
+
+        assert_eq(tree.delete_node(2), true);
+        assert_eq(tree.delete_node(2), false);
+        assert_eq(tree.insert_node(7), true);
+
+        auto after = tree.acquire_snapshot();
+
+        debug::vec_assert_eq(snapshot_values<int32_t>(before), std::vector<int32_t>{1, 2, 5, 8, 9});
+        debug::vec_assert_eq(snapshot_values<int32_t>(after), std::vector<int32_t>{1, 5, 7, 8, 9});
+        assert_eq(before.size(), size_t{5});
+        assert_eq(after.size(), size_t{5});
+        assert_eq(before.contains(2), true);
+        assert_eq(after.contains(2), false);
+        assert_eq(after.contains(7), true);
+
+        tree.release_snapshot(before);
+        tree.release_snapshot(after);
+    }
+
+    // Random updates against std::set, with snapshots of old versions checked as they're released.
+    {
+        PersistentBinaryTree<int32_t> tree;
+        std::set<int32_t>             expected;
+
+        std::vector<std::pair<PersistentBinaryTree<int32_t>::Snapshot, std::vector<int32_t>>> snapshots;
+
+        std::mt19937 rng{11};
+        for (size_t operation = 0; operation < 100'000; ++operation) {
+            int32_t value = static_cast<int32_t>(rng() % 3000);
+            if (rng() % 3 == 0) {
+                assert_eq(tree.delete_node(value), expected.erase(value) == 1);
+            } else {
+                assert_eq(tree.insert_node(value), expected.insert(value).second);
+            }
+
+            if (operation % 1000 == 0) {
+                snapshots.push_back({tree.acquire_snapshot(), std::vector<int32_t>(expected.begin(), expected.end())});
+            }
+            if (operation % 1500 == 0 && !snapshots.empty()) {
+                size_t released_idx = rng() % snapshots.size();
+                debug::vec_assert_eq(snapshot_values<int32_t>(snapshots[released_idx].first), snapshots[released_idx].second);
+                tree.release_snapshot(snapshots[released_idx].first);
+                snapshots.erase(snapshots.begin() + static_cast<ptrdiff_t>(released_idx));
+            }
+        }
+
+        for (auto const& [snapshot, values] : snapshots) {
+            debug::vec_assert_eq(snapshot_values<int32_t>(snapshot), values);
+            tree.release_snapshot(snapshot);
+        }
+
+        assert_eq(tree.size(), expected.size());
+
+        // With no snapshot left, only the blocks holding the current version remain: a few nodes
+        // per block are enough to keep one alive, but far fewer blocks than were ever allocated.
+        size_t live_block_count = tree.block_count();
+        assert_eq(live_block_count <= expected.size(), true);
+        assert_eq(live_block_count < tree.blocks.size(), true);
+
+        // Once the tree is emptied, every block but the one being allocated from is freed.
+        std::vector<int32_t> values(expected.begin(), expected.end());
+        for (int32_t value : values) {
+            assert_eq(tree.delete_node(value), true);
+        }
+        assert_eq(tree.size(), size_t{0});
+        assert_eq(tree.block_count(), size_t{1});
+
+        // A snapshot taken before emptying the tree keeps its blocks alive until it's released.
+        for (int32_t value : values) {
+            tree.insert_node(value);
+        }
+        auto full_snapshot = tree.acquire_snapshot();
+        for (int32_t value : values) {
+            tree.delete_node(value);
+        }
+        assert_eq(tree.block_count() > 1, true);
+        debug::vec_assert_eq(snapshot_values<int32_t>(full_snapshot), values);
+        tree.release_snapshot(full_snapshot);
+        assert_eq(tree.block_count(), size_t{1});
+    }
+
+    // Readers take snapshots while a writer keeps updating the tree.
+    {
+        constexpr size_t READER_COUNT      = 3;
+        constexpr size_t WRITER_OPERATIONS = 100'000;
+
+        PersistentBinaryTree<int32_t> tree;
+        std::atomic<bool>             writer_done   = false;
+        std::atomic<size_t>           reader_errors = 0;
+
+        std::vector<std::thread> readers;
+        for (size_t reader_idx = 0; reader_idx < READER_COUNT; ++reader_idx) {
+            readers.emplace_back([&]() {
+                while (!writer_done.load()) {
+                    auto snapshot = tree.acquire_snapshot();
+
+                    std::vector<int32_t> values = snapshot_values<int32_t>(snapshot);
+                    bool sorted = std::adjacent_find(values.begin(), values.end(), std::greater_equal<int32_t>{}) == values.end();
+                    if (!sorted || values.size() != snapshot.size()) {
+                        reader_errors.fetch_add(1);
+                    }
+
+                    tree.release_snapshot(snapshot);
+                }
+            });
+        }
+
+        std::mt19937 rng{12};
+        for (size_t operation = 0; operation < WRITER_OPERATIONS; ++operation) {
+            int32_t value = static_cast<int32_t>(rng() % 2000);
+            if (rng() % 2 == 0) {
+                tree.delete_node(value);
+            } else {
+                tree.insert_node(value);
+            }
+        }
+        writer_done.store(true);
+
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        assert_eq(reader_errors.load(), size_t{0});
+    }
+
+    report_success();
+    return 0;
+}
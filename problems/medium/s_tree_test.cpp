@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <common.hpp>
+#include <limits>
+#include <random>
+#include <s_tree.hpp>
+#include <vector>
+
+template <typename T>
+static void assert_matches_lower_bound(STree<T> const& tree, std::vector<T> const& sorted_keys, T value) {
+    auto     expected = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), value);
+    T const* found    = tree.lower_bound(value);
+    if (expected == sorted_keys.end()) {
+        assert_eq(found == nullptr, true);
+    } else {
+        assert_eq(found != nullptr, true);
+        assert_eq(*found, *expected);
+        assert_eq(tree.contains(value), *expected == value);
+    }
+}
+
+// Checks random key sets of every size up to a few layers deep, against values from the whole range
+// of the keys plus some margin.
+template <typename T>
+static void test_random_sizes(size_t max_key_count, size_t key_count_step, int64_t min_key, int64_t max_key) {
+    std::mt19937_64                        rng{static_cast<uint64_t>(max_key_count)};
+    std::uniform_int_distribution<int64_t> key_distribution{min_key, max_key};
+
+    for (size_t key_count = 1; key_count <= max_key_count; key_count += key_count_step) {
+        std::vector<T> sorted_keys(key_count);
+        for (T& key : sorted_keys) {
+            key = static_cast<T>(key_distribution(rng));
+        }
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+
+        STree<T> tree{sorted_keys};
+        assert_eq(tree.size(), key_count);
+
+        for (size_t query = 0; query < 300; ++query) {
+            assert_matches_lower_bound(tree, sorted_keys, static_cast<T>(key_distribution(rng)));
+        }
+        assert_matches_lower_bound(tree, sorted_keys, std::numeric_limits<T>::min());
+        assert_matches_lower_bound(tree, sorted_keys, std::numeric_limits<T>::max());
+        for (T key : sorted_keys) {
+            assert_eq(tree.contains(key), true);
+        }
+    }
+}
+
+int main() {
+    {
+        STree<int32_t> tree{std::vector<int32_t>{}};
+        assert_eq(tree.size(), size_t{0});
+        assert_eq(tree.lower_bound(0) == nullptr, true);
+        assert_eq(tree.contains(0), false);
+    }
+
+    {
+        std::vector<int32_t> sorted_keys = {-7, -3, 0, 2, 2, 2, 5, 9, 13, 21};
+        STree<int32_t>       tree{sorted_keys};
+
+        assert_eq(*tree.lower_bound(-100), -7);
+        assert_eq(*tree.lower_bound(-6), -3);
+        assert_eq(*tree.lower_bound(1), 2);
+        assert_eq(*tree.lower_bound(3), 5);
+        assert_eq(*tree.lower_bound(21), 21);
+        assert_eq(tree.lower_bound(22) == nullptr, true);
+    }
+
+    // The largest value is also the padding of the nodes, it must still be found when it's a key.
+    {
+        constexpr int32_t MAX = std::numeric_limits<int32_t>::max();
+
+        std::vector<int32_t> sorted_keys(1000);
+        for (size_t idx = 0; idx < sorted_keys.size(); ++idx) {
+            sorted_keys[idx] = (idx < 700) ? static_cast<int32_t>(idx) : MAX;
+        }
+
+        STree<int32_t> tree{sorted_keys};
+        assert_eq(*tree.lower_bound(699), 699);
+        assert_eq(*tree.lower_bound(700), MAX);
+        assert_eq(tree.lower_bound(MAX) - tree.keys.data(), ptrdiff_t{700});
+        assert_eq(tree.contains(MAX), true);
+    }
+
+    test_random_sizes<int32_t>(5000, 7, -100'000, 100'000);
+    test_random_sizes<int64_t>(3000, 5, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+    test_random_sizes<uint16_t>(3000, 11, 0, 5000);
+    test_random_sizes<int8_t>(1000, 3, -128, 127);
+
+    // Larger than the caches, four layers deep.
+    {
+        constexpr size_t KEY_COUNT = size_t{1} << 22;
+
+        std::vector<int32_t> sorted_keys(KEY_COUNT);
+        for (size_t idx = 0; idx < KEY_COUNT; ++idx) {
+            sorted_keys[idx] = 3 * static_cast<int32_t>(idx);
+        }
+
+        STree<int32_t>                         tree{sorted_keys};
+        std::mt19937                           rng{7};
+        std::uniform_int_distribution<int32_t> value_distribution{-5, 3 * static_cast<int32_t>(KEY_COUNT) + 5};
+        for (size_t query = 0; query < 100'000; ++query) {
+            assert_matches_lower_bound(tree, sorted_keys, value_distribution(rng));
+        }
+    }
+
+    report_success();
+    return 0;
+}